@@ -117,6 +117,38 @@ thread_sha256_file (GTask *task, GFile *file, gpointer task_data, GCancellable *
 	g_checksum_free (checksum);
 }
 
+/* HexChat hashes a receive while writing it, unless it couldn't read back
+ * the part a resume started from or is too old to know how. Returns NULL
+ * then. */
+static char *
+get_received_sha256 (const char *destfile)
+{
+	hexchat_list *list;
+	const char *sha256;
+	char *result = NULL;
+
+	list = hexchat_list_get (ph, "dcc");
+	if (!list)
+		return NULL;
+
+	while (hexchat_list_next (ph, list))
+	{
+		/* type 1 is a receive, status 3 is done */
+		if (hexchat_list_int (ph, list, "type") == 1 &&
+			hexchat_list_int (ph, list, "status") == 3 &&
+			g_strcmp0 (hexchat_list_str (ph, list, "destfile"), destfile) == 0)
+		{
+			sha256 = hexchat_list_str (ph, list, "sha256");
+			if (sha256)
+				result = g_strdup (sha256);
+			break;
+		}
+	}
+
+	hexchat_list_free (ph, list);
+	return result;
+}
+
 static int
 dccrecv_cb (char *word[], void *userdata)
 {
@@ -125,6 +157,7 @@ dccrecv_cb (char *word[], void *userdata)
 	GFile *file;
 	const char *dcc_completed_dir;
 	char *filename;
+	char *sha256;
 
 	if (hexchat_get_prefs (ph, "dcc_completed_dir", &dcc_completed_dir, NULL) == 1 && dcc_completed_dir[0] != '\0')
 		filename = g_build_filename (dcc_completed_dir, word[1], NULL);
@@ -143,6 +176,18 @@ dccrecv_cb (char *word[], void *userdata)
 	callback_data->channel = g_strdup(hexchat_get_info(ph, "channel"));
 	callback_data->send_message = FALSE;
 
+	sha256 = get_received_sha256 (word[2]);
+	if (sha256)
+	{
+		print_sha256_result (callback_data, sha256, filename, NULL);
+		g_free (callback_data->servername);
+		g_free (callback_data->channel);
+		g_free (callback_data);
+		g_free (sha256);
+		g_free (filename);
+		g_free (filename_fs);
+		return HEXCHAT_EAT_NONE;
+	}
 
 	file = g_file_new_for_path (filename_fs);
 	task = g_task_new (file, NULL, (GAsyncReadyCallback) file_sha256_complete, (gpointer)callback_data);
@@ -92,8 +92,34 @@ static const signed char fish_unbase64[256] = {
 static OSSL_PROVIDER *legacy_provider;
 static OSSL_PROVIDER *default_provider;
 static OSSL_LIB_CTX *ossl_ctx;
+static EVP_CIPHER *bf_cbc;
+static EVP_CIPHER *bf_ecb;
 #endif
 
+/* Contexts that already have a key set up, keyed by mode, direction and key.
+ * Setting a Blowfish key is much slower than encrypting a line with it. */
+#define MAX_CACHED_CIPHERS 32
+static GHashTable *cipher_cache;
+
+/**
+ * Wipe the key held by a cipher cache id before freeing it
+ */
+static void cipher_id_free(GBytes *id) {
+    gsize size;
+    gpointer data = (gpointer) g_bytes_get_data(id, &size);
+
+    memset(data, 0, size);
+    g_bytes_unref(id);
+}
+
+/**
+ * Forget every cached cipher context, e.g. after keys were changed
+ */
+void fish_cipher_cache_clear(void) {
+    if (cipher_cache)
+        g_hash_table_remove_all(cipher_cache);
+}
+
 int fish_init(void)
 {
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
@@ -118,7 +144,22 @@ int fish_init(void)
 
 void fish_deinit(void)
 {
+    if (cipher_cache) {
+        g_hash_table_destroy(cipher_cache);
+        cipher_cache = NULL;
+    }
+
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (bf_cbc) {
+        EVP_CIPHER_free(bf_cbc);
+        bf_cbc = NULL;
+    }
+
+    if (bf_ecb) {
+        EVP_CIPHER_free(bf_ecb);
+        bf_ecb = NULL;
+    }
+
     if (legacy_provider) {
         OSSL_PROVIDER_unload(legacy_provider);
         legacy_provider = NULL;
@@ -225,6 +266,87 @@ char *fish_base64_decode(const char *message, size_t *final_len) {
     return bytes;
 }
 
+/**
+ * Get the Blowfish cipher for a mode
+ *
+ * @param [in] mode  EVP_CIPH_ECB_MODE or EVP_CIPH_CBC_MODE
+ * @return The cipher or NULL
+ */
+static const EVP_CIPHER *get_cipher(int mode) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (mode == EVP_CIPH_CBC_MODE) {
+        if (!bf_cbc)
+            bf_cbc = EVP_CIPHER_fetch(ossl_ctx, "BF-CBC", NULL);
+        return bf_cbc;
+    } else if (mode == EVP_CIPH_ECB_MODE) {
+        if (!bf_ecb)
+            bf_ecb = EVP_CIPHER_fetch(ossl_ctx, "BF-ECB", NULL);
+        return bf_ecb;
+    }
+#else
+    if (mode == EVP_CIPH_CBC_MODE)
+        return EVP_bf_cbc();
+    else if (mode == EVP_CIPH_ECB_MODE)
+        return EVP_bf_ecb();
+#endif
+    return NULL;
+}
+
+/**
+ * Get a cipher context with the key already set, from the cache or new
+ *
+ * @param [in] key     Bytes of key
+ * @param [in] keylen  Size of key
+ * @param [in] encode  1 or encrypt 0 for decrypt
+ * @param [in] mode    EVP_CIPH_ECB_MODE or EVP_CIPH_CBC_MODE
+ * @return The context, owned by the cache, or NULL
+ */
+static EVP_CIPHER_CTX *get_cipher_ctx(const char *key, size_t keylen, int encode, int mode) {
+    EVP_CIPHER_CTX *ctx;
+    const EVP_CIPHER *cipher;
+    unsigned char *id_data;
+    GBytes *id;
+
+    id_data = g_malloc(keylen + 2);
+    id_data[0] = mode;
+    id_data[1] = encode;
+    memcpy(id_data + 2, key, keylen);
+    id = g_bytes_new_take(id_data, keylen + 2);
+
+    if (!cipher_cache)
+        cipher_cache = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+                                             (GDestroyNotify) cipher_id_free,
+                                             (GDestroyNotify) EVP_CIPHER_CTX_free);
+
+    ctx = g_hash_table_lookup(cipher_cache, id);
+    if (ctx) {
+        cipher_id_free(id);
+        return ctx;
+    }
+
+    cipher = get_cipher(mode);
+    if (!cipher || !(ctx = EVP_CIPHER_CTX_new())) {
+        cipher_id_free(id);
+        return NULL;
+    }
+
+    /* Initialise the cipher operation only with mode, then set custom key
+     * length and the key itself */
+    if (!EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, encode) ||
+        !EVP_CIPHER_CTX_set_key_length(ctx, keylen) ||
+        1 != EVP_CipherInit_ex(ctx, NULL, NULL, (const unsigned char *) key, NULL, encode)) {
+        EVP_CIPHER_CTX_free(ctx);
+        cipher_id_free(id);
+        return NULL;
+    }
+
+    if (g_hash_table_size(cipher_cache) >= MAX_CACHED_CIPHERS)
+        g_hash_table_remove_all(cipher_cache);
+    g_hash_table_insert(cipher_cache, id, ctx);
+
+    return ctx;
+}
+
 /**
  * Encrypt or decrypt data with Blowfish cipher, support binary data.
  *
@@ -249,7 +371,6 @@ char *fish_base64_decode(const char *message, size_t *final_len) {
  */
 char *fish_cipher(const char *plaintext, size_t plaintext_len, const char *key, size_t keylen, int encode, int mode, size_t *ciphertext_len) {
     EVP_CIPHER_CTX *ctx;
-    EVP_CIPHER *cipher = NULL;
     int bytes_written = 0;
     unsigned char *ciphertext = NULL;
     unsigned char *iv_ciphertext = NULL;
@@ -276,20 +397,6 @@ char *fish_cipher(const char *plaintext, size_t plaintext_len, const char *key,
             plaintext += 8;
             plaintext_len -= 8;
         }
-
-#if OPENSSL_VERSION_NUMBER >= 0x30000000L
-        cipher = EVP_CIPHER_fetch(ossl_ctx, "BF-CBC", NULL);
-#else
-        cipher = (EVP_CIPHER *) EVP_bf_cbc();
-#endif
-
-    } else if (mode == EVP_CIPH_ECB_MODE) {
-
-#if OPENSSL_VERSION_NUMBER >= 0x30000000L
-        cipher = EVP_CIPHER_fetch(ossl_ctx, "BF-ECB", NULL);
-#else
-        cipher = (EVP_CIPHER *) EVP_bf_ecb();
-#endif
     }
 
     /* Zero Padding */
@@ -300,20 +407,12 @@ char *fish_cipher(const char *plaintext, size_t plaintext_len, const char *key,
     ciphertext = (unsigned char *) g_malloc0(block_size);
     memcpy(ciphertext, plaintext, plaintext_len);
 
-    /* Create and initialise the context */
-    if (!(ctx = EVP_CIPHER_CTX_new()))
-        return NULL;
-
-    /* Initialise the cipher operation only with mode */
-    if (!EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, encode))
+    /* Get a context with this key set up */
+    if (!(ctx = get_cipher_ctx(key, keylen, encode, mode)))
         return NULL;
 
-    /* Set custom key length */
-    if (!EVP_CIPHER_CTX_set_key_length(ctx, keylen))
-        return NULL;
-
-    /* Finish the initiation the cipher operation */
-    if (1 != EVP_CipherInit_ex(ctx, NULL, NULL, (const unsigned char *) key, iv, encode))
+    /* Start over with the same key, and this message's IV */
+    if (1 != EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, encode))
         return NULL;
 
     /* We will manage this */
@@ -331,9 +430,6 @@ char *fish_cipher(const char *plaintext, size_t plaintext_len, const char *key,
 
     *ciphertext_len += bytes_written;
 
-    /* Clean up */
-    EVP_CIPHER_CTX_free(ctx);
-
 
     if (mode == EVP_CIPH_CBC_MODE && encode == 1) {
         /* Join IV + DATA */
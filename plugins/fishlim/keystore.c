@@ -25,6 +25,7 @@
 #include "config.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "irc.h"
@@ -35,6 +36,17 @@
 
 static char *keystore_password = NULL;
 
+/* The key store file as last read, and the keys looked up in it since.
+ * Both are thrown away when the file changes, on disk or through us. */
+static GKeyFile *cached_keyfile = NULL;
+static GStatBuf cached_stat;
+static GHashTable *cached_keys = NULL;
+
+struct cached_key {
+    char *key; /* NULL if the nick has none */
+    enum fish_mode mode;
+};
+
 
 /**
  * Opens the key store file: ~/.config/hexchat/addon_fishlim.conf
@@ -52,6 +64,52 @@ static GKeyFile *getConfigFile(void) {
 }
 
 
+static void free_cached_key(struct cached_key *cached) {
+    if (cached->key) {
+        memset(cached->key, 0, strlen(cached->key));
+        g_free(cached->key);
+    }
+    g_free(cached);
+}
+
+/**
+ * Forgets the cached key store, it will be read again when next needed.
+ */
+static void invalidate_cache(void) {
+    if (cached_keyfile) {
+        g_key_file_free(cached_keyfile);
+        cached_keyfile = NULL;
+    }
+
+    if (cached_keys)
+        g_hash_table_remove_all(cached_keys);
+
+    fish_cipher_cache_clear();
+}
+
+/**
+ * Returns the key store file, only reading it if it changed since last time.
+ */
+static GKeyFile *getCachedConfigFile(void) {
+    gchar *filename = get_config_filename();
+    GStatBuf st;
+
+    memset(&st, 0, sizeof(st));
+    g_stat(filename, &st);
+    g_free(filename);
+
+    if (!cached_keyfile ||
+        st.st_mtime != cached_stat.st_mtime ||
+        st.st_size != cached_stat.st_size ||
+        st.st_ino != cached_stat.st_ino) {
+        invalidate_cache();
+        cached_keyfile = getConfigFile();
+        cached_stat = st;
+    }
+
+    return cached_keyfile;
+}
+
 /**
  * Returns the key store password, or the default.
  */
@@ -103,8 +161,7 @@ static gchar *get_nick_value(GKeyFile *keyfile, const char *nick, const char *it
 /**
  * Extracts a key from the key store file.
  */
-char *keystore_get_key(const char *nick, enum fish_mode *mode) {
-    GKeyFile *keyfile;
+static char *read_key(GKeyFile *keyfile, const char *nick, enum fish_mode *mode) {
     char *escaped_nick;
     gchar *value, *key_mode;
     int encrypted_mode;
@@ -113,11 +170,9 @@ char *keystore_get_key(const char *nick, enum fish_mode *mode) {
     char *decrypted;
 
     /* Get the key */
-    keyfile = getConfigFile();
     escaped_nick = escape_nickname(nick);
     value = get_nick_value(keyfile, escaped_nick, "key");
     key_mode = get_nick_value(keyfile, escaped_nick, "mode");
-    g_key_file_free(keyfile);
     g_free(escaped_nick);
 
     /* Determine cipher mode */
@@ -155,6 +210,28 @@ char *keystore_get_key(const char *nick, enum fish_mode *mode) {
     }
 }
 
+/**
+ * Gets the key for a nick, from memory unless the key store changed.
+ */
+char *keystore_get_key(const char *nick, enum fish_mode *mode) {
+    GKeyFile *keyfile = getCachedConfigFile();
+    struct cached_key *cached;
+
+    if (!cached_keys)
+        cached_keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify) free_cached_key);
+
+    cached = g_hash_table_lookup(cached_keys, nick);
+    if (!cached) {
+        cached = g_new0(struct cached_key, 1);
+        cached->key = read_key(keyfile, nick, &cached->mode);
+        g_hash_table_insert(cached_keys, g_strdup(nick), cached);
+    }
+
+    *mode = cached->mode;
+    return g_strdup(cached->key);
+}
+
 /**
  * Deletes a nick and the associated key in the key store file.
  */
@@ -252,6 +329,7 @@ gboolean keystore_store_key(const char *nick, const char *key, enum fish_mode mo
     
     /* Save key store file */
     ok = save_keystore(keyfile);
+    invalidate_cache();
     
   end:
     g_key_file_free(keyfile);
@@ -271,8 +349,21 @@ gboolean keystore_delete_nick(const char *nick) {
     
     /* Save */
     if (ok) save_keystore(keyfile);
+    invalidate_cache();
     
     g_key_file_free(keyfile);
     g_free(escaped_nick);
     return ok;
 }
+
+/**
+ * Frees the cached key store.
+ */
+void keystore_deinit(void) {
+    invalidate_cache();
+
+    if (cached_keys) {
+        g_hash_table_destroy(cached_keys);
+        cached_keys = NULL;
+    }
+}
@@ -831,6 +831,7 @@ int hexchat_plugin_init(hexchat_plugin *plugin_handle,
 int hexchat_plugin_deinit(void) {
     g_clear_pointer(&pending_exchanges, g_hash_table_destroy);
     dh1080_deinit();
+    keystore_deinit();
     fish_deinit();
 
     hexchat_printf(ph, "%s plugin unloaded\n", plugin_name);
@@ -49,3 +49,11 @@ keystore_delete_nick(const char *nick)
 {
     return TRUE;
 }
+
+/**
+ * Frees the cached key store.
+ */
+void
+keystore_deinit(void)
+{
+}
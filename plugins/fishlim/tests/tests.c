@@ -123,6 +123,80 @@ test_cbc(void)
     }
 }
 
+/**
+ * Check that reused cipher contexts don't mix up keys, modes or directions
+ */
+static void
+test_cipher_reuse(void)
+{
+    char *b64[4];
+    char *de = NULL;
+    char keys[4][57];
+    char message[200];
+    int i, round;
+    enum fish_mode mode;
+
+    for (i = 0; i < 4; ++i)
+        random_string(keys[i], 56);
+    random_string(message, 199);
+
+    for (round = 0; round < 3; ++round) {
+        for (mode = FISH_ECB_MODE; mode <= FISH_CBC_MODE; ++mode) {
+            /* Interleave keys so each context is used after the others */
+            for (i = 0; i < 4; ++i) {
+                b64[i] = fish_encrypt(keys[i], 56, message, 199, mode);
+                g_assert_nonnull(b64[i]);
+            }
+
+            for (i = 0; i < 4; ++i) {
+                de = fish_decrypt_str(keys[i], 56, b64[i], mode);
+                g_assert_cmpstr(de, ==, message);
+                g_free(de);
+
+                /* Wrong key must not decrypt, even with its context cached */
+                de = fish_decrypt_str(keys[(i + 1) % 4], 56, b64[i], mode);
+                g_assert_cmpstr(de, !=, message);
+                g_free(de);
+            }
+
+            for (i = 0; i < 4; ++i)
+                g_free(b64[i]);
+        }
+    }
+}
+
+/**
+ * Measure lines per second encrypted and decrypted with one key, run with -m perf
+ */
+static void
+test_cipher_perf(void)
+{
+    char *b64 = NULL;
+    char *de = NULL;
+    char key[57];
+    char message[400];
+    double elapsed;
+    int i, count = 100000;
+    enum fish_mode mode;
+
+    random_string(key, 56);
+    random_string(message, 399);
+
+    for (mode = FISH_ECB_MODE; mode <= FISH_CBC_MODE; ++mode) {
+        g_test_timer_start();
+        for (i = 0; i < count; ++i) {
+            b64 = fish_encrypt(key, 56, message, 399, mode);
+            de = fish_decrypt_str(key, 56, b64, mode);
+            g_free(b64);
+            g_free(de);
+        }
+        elapsed = g_test_timer_elapsed();
+
+        g_test_maximized_result(count / elapsed, "%s: %.0f lines/s",
+                                mode == FISH_ECB_MODE ? "ECB" : "CBC", count / elapsed);
+    }
+}
+
 /**
  * Check the calculation of final length from an encoded string in Base64
  */
@@ -271,6 +345,9 @@ main(int argc, char *argv[]) {
 
     g_test_add_func("/fishlim/ecb", test_ecb);
     g_test_add_func("/fishlim/cbc", test_cbc);
+    g_test_add_func("/fishlim/cipher_reuse", test_cipher_reuse);
+    if (g_test_perf())
+        g_test_add_func("/fishlim/perf/cipher", test_cipher_perf);
     g_test_add_func("/fishlim/base64_len", test_base64_len);
     g_test_add_func("/fishlim/base64_fish_len", test_base64_fish_len);
     g_test_add_func("/fishlim/base64_ecb_len", test_base64_ecb_len);
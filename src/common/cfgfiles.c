@@ -201,6 +201,58 @@ char *cfg_get_str(char *cfg, const char *var, char *dest, int dest_len) {
   }
 }
 
+/* Split the "var = value" line at cfg in place. Returns the start of the
+   next line, or NULL at the end of the buffer; *var is NULL for a line
+   that isn't a setting. */
+char *cfg_next_pair(char *cfg, char **var, char **value) {
+  char *next, *p;
+
+  if (*cfg == 0)
+    return NULL;
+
+  next = strchr(cfg, '\n');
+  if (next)
+    *next++ = 0;
+  else
+    next = cfg + strlen(cfg);
+
+  *var = *value = NULL;
+  p = cfg + strcspn(cfg, " =");
+  if (p == cfg || *p == 0)
+    return next;
+
+  if (*p == ' ') {
+    *p++ = 0;
+    while (*p == ' ')
+      p++;
+    if (*p == '=')
+      p++;
+  } else {
+    *p++ = 0;
+  }
+  while (*p == ' ')
+    p++;
+
+  *var = cfg;
+  *value = p;
+  return next;
+}
+
+/* Index a whole config file by variable name in one pass, for looking
+   up many values. The table points into cfg, which it modifies. As with
+   cfg_get_str(), the first of repeated variables wins. */
+GHashTable *cfg_parse(char *cfg) {
+  GHashTable *table;
+  char *var, *value;
+
+  table = casemap_hash_table_new((void *)g_ascii_strcasecmp, NULL, NULL);
+  while ((cfg = cfg_next_pair(cfg, &var, &value))) {
+    if (var && !g_hash_table_contains(table, var))
+      g_hash_table_insert(table, var, value);
+  }
+  return table;
+}
+
 static int cfg_put_str(int fh, char *var, char *value) {
   char buf[512];
   int len;
@@ -474,6 +526,8 @@ const struct prefs vars[] = {
     {"irc_join_delay", P_OFFINT(hex_irc_join_delay), TYPE_INT, 0},
     {"irc_logging", P_OFFINT(hex_irc_logging), TYPE_BOOL, 0},
     {"irc_logmask", P_OFFSET(hex_irc_logmask), TYPE_STR, 0},
+    {"irc_netsplit_summary", P_OFFINT(hex_irc_netsplit_summary), TYPE_BOOL,
+     0},
     {"irc_nick1", P_OFFSET(hex_irc_nick1), TYPE_STR, 0},
     {"irc_nick2", P_OFFSET(hex_irc_nick2), TYPE_STR, 0},
     {"irc_nick3", P_OFFSET(hex_irc_nick3), TYPE_STR, 0},
@@ -736,6 +790,7 @@ void load_default_config(void) {
   prefs.hex_irc_reconnect_rejoin = 1;
   prefs.hex_irc_cap_server_time = 1;
   prefs.hex_irc_logging = 1;
+  prefs.hex_irc_netsplit_summary = 1;
   prefs.hex_irc_who_join =
       1; /* Can kick with inordinate amount of channels, required for some of
             our features though, TODO: add cap like away check? */
@@ -905,8 +960,9 @@ int make_dcc_dirs(void) {
 }
 
 int load_config(void) {
-  char *cfg, *sp;
-  int res, val, i;
+  char *cfg, *sp, *value;
+  GHashTable *table;
+  int i;
 
   g_assert(check_config_dir() == 0);
 
@@ -916,23 +972,25 @@ int load_config(void) {
   /* If the config is incomplete we have the default values loaded */
   load_default_config();
 
+  table = cfg_parse(cfg);
   i = 0;
   do {
-    switch (vars[i].type) {
-    case TYPE_STR:
-      cfg_get_str(cfg, vars[i].name, (char *)&prefs + vars[i].offset,
-                  vars[i].len);
-      break;
-    case TYPE_BOOL:
-    case TYPE_INT:
-      val = cfg_get_int_with_result(cfg, vars[i].name, &res);
-      if (res)
-        *((int *)&prefs + vars[i].offset) = val;
-      break;
+    value = g_hash_table_lookup(table, vars[i].name);
+    if (value) {
+      switch (vars[i].type) {
+      case TYPE_STR:
+        safe_strcpy((char *)&prefs + vars[i].offset, value, vars[i].len);
+        break;
+      case TYPE_BOOL:
+      case TYPE_INT:
+        *((int *)&prefs + vars[i].offset) = atoi(value);
+        break;
+      }
     }
     i++;
   } while (vars[i].name);
 
+  g_hash_table_destroy(table);
   g_free(cfg);
 
   if (prefs.hex_gui_win_height < 138)
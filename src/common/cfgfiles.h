@@ -29,6 +29,8 @@
 extern char *xdir;
 extern const char * const languages[LANGUAGES_LENGTH];
 
+char *cfg_next_pair (char *cfg, char **var, char **value);
+GHashTable *cfg_parse (char *cfg);
 char *cfg_get_str (char *cfg, const char *var, char *dest, int dest_len);
 int cfg_get_bool (char *var);
 int cfg_get_int_with_result (char *cfg, char *var, int *result);
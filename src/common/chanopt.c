@@ -43,6 +43,7 @@
 
 
 static GSList *chanopt_list = NULL;
+static GHashTable *chanopt_index = NULL;	/* "network\nchannel" -> chanopt_in_memory */
 static gboolean chanopt_open = FALSE;
 static gboolean chanopt_changed = FALSE;
 
@@ -203,21 +204,21 @@ typedef struct
 static chanopt_in_memory *
 chanopt_find (char *network, char *channel, gboolean add_new)
 {
-	GSList *list;
 	chanopt_in_memory *co;
+	char *key;
 	int i;
 
-	for (list = chanopt_list; list; list = list->next)
+	if (!chanopt_index)
+		chanopt_index = casemap_hash_table_new ((void *)g_ascii_strcasecmp, g_free, NULL);
+
+	key = g_strconcat (network, "\n", channel, NULL);
+	co = g_hash_table_lookup (chanopt_index, key);
+	if (co || !add_new)
 	{
-		co = list->data;
-		if (!g_ascii_strcasecmp (co->channel, channel) &&
-			 !g_ascii_strcasecmp (co->network, network))
-			return co;
+		g_free (key);
+		return co;
 	}
 
-	if (!add_new)
-		return NULL;
-
 	/* allocate a new one */
 	co = g_new0 (chanopt_in_memory, 1);
 	co->channel = g_strdup (channel);
@@ -232,6 +233,7 @@ chanopt_find (char *network, char *channel, gboolean add_new)
 	}
 
 	chanopt_list = g_slist_prepend (chanopt_list, co);
+	g_hash_table_insert (chanopt_index, key, co);
 	chanopt_changed = TRUE;
 
 	return co;
@@ -259,46 +261,41 @@ chanopt_add_opt (chanopt_in_memory *co, char *var, int new_value)
 static void
 chanopt_load_all (void)
 {
-	int fh;
-	char buf[256];
-	char *eq;
+	char *filename, *cfg, *line, *var, *value;
 	char *network = NULL;
 	chanopt_in_memory *current = NULL;
 
 	/* 1. load the old file into our GSList */
-	fh = hexchat_open_file ("chanopt.conf", O_RDONLY, 0, 0);
-	if (fh != -1)
+	filename = g_build_filename (get_xdir (), "chanopt.conf", NULL);
+	if (g_file_get_contents (filename, &cfg, NULL, NULL))
 	{
-		while (waitline (fh, buf, sizeof buf, FALSE) != -1)
+		line = cfg;
+		while ((line = cfg_next_pair (line, &var, &value)))
 		{
-			eq = strchr (buf, '=');
-			if (!eq)
+			if (!var)
 				continue;
-			eq[0] = 0;
-
-			if (eq != buf && eq[-1] == ' ')
-				eq[-1] = 0;
 
-			if (!strcmp (buf, "network"))
+			if (!strcmp (var, "network"))
 			{
-				g_free (network);
-				network = g_strdup (eq + 2);
+				network = value;
 			}
-			else if (!strcmp (buf, "channel"))
+			else if (!strcmp (var, "channel"))
 			{
-				current = chanopt_find (network, eq + 2, TRUE);
-				chanopt_changed = FALSE;
+				if (network)
+				{
+					current = chanopt_find (network, value, TRUE);
+					chanopt_changed = FALSE;
+				}
 			}
 			else
 			{
 				if (current)
-					chanopt_add_opt (current, buf, str_to_chanopt (eq + 2));
+					chanopt_add_opt (current, var, str_to_chanopt (value));
 			}
-
 		}
-		close (fh);
-		g_free (network);
+		g_free (cfg);
 	}
+	g_free (filename);
 }
 
 void
@@ -455,6 +452,11 @@ cont:
 	{
 		g_slist_free (chanopt_list);
 		chanopt_list = NULL;
+		if (chanopt_index)
+		{
+			g_hash_table_destroy (chanopt_index);
+			chanopt_index = NULL;
+		}
 	}
 
 	chanopt_open = FALSE;
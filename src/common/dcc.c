@@ -27,6 +27,8 @@
 /* Required to make lseek use off64_t, but doesn't work on Windows */
 #define _FILE_OFFSET_BITS 64
 
+#include "config.h"
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -46,6 +48,9 @@
 #else
 #include <unistd.h>
 #endif
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
 
 #include "fe.h"
 #include "hexchat.h"
@@ -65,6 +70,11 @@
 #define lseek _lseeki64
 #endif
 
+/* received data is written to disk in batches of up to this much, or of
+ * what's left of the file if that's less */
+#define DCC_RECV_BUFSIZE (4 * 1024 * 1024)
+#define DCC_RECV_MINBUFSIZE (64 * 1024)
+
 /* interval timer to detect timeouts */
 static int timeout_timer = 0;
 
@@ -83,6 +93,7 @@ static struct DCC *new_dcc(void);
 static void dcc_close(struct DCC *dcc, enum dcc_state dccstat, int destroy);
 static gboolean dcc_send_data(GIOChannel *, GIOCondition, struct DCC *);
 static gboolean dcc_read(GIOChannel *, GIOCondition, struct DCC *);
+static gboolean dcc_flush_recv(struct DCC *dcc);
 static gboolean dcc_read_ack(GIOChannel *source, GIOCondition condition,
                              struct DCC *dcc);
 static int dcc_check_timeouts(void);
@@ -348,6 +359,7 @@ static void dcc_close(struct DCC *dcc, enum dcc_state dccstat, int destroy) {
   dcc_remove_from_sum(dcc);
 
   if (dcc->fp != -1) {
+    dcc_flush_recv(dcc);
     close(dcc->fp);
     dcc->fp = -1;
 
@@ -362,6 +374,11 @@ static void dcc_close(struct DCC *dcc, enum dcc_state dccstat, int destroy) {
     }
   }
 
+  g_free(dcc->recvbuf);
+  dcc->recvbuf = NULL;
+  dcc->recvbuf_used = 0;
+  g_clear_pointer(&dcc->checksum, g_checksum_free);
+
   dcc->dccstat = dccstat;
   if (dcc->dccchat) {
     g_free(dcc->dccchat);
@@ -375,6 +392,7 @@ static void dcc_close(struct DCC *dcc, enum dcc_state dccstat, int destroy) {
     g_free(dcc->file);
     g_free(dcc->destfile);
     g_free(dcc->nick);
+    g_free(dcc->sha256);
     g_free(dcc);
     if (dcc_list == NULL && timeout_timer != 0) {
       fe_timeout_remove(timeout_timer);
@@ -578,12 +596,66 @@ static void dcc_send_ack(struct DCC *dcc) {
   send(dcc->sok, (char *)&pos, 4, 0);
 }
 
+/* Write out what dcc_read() buffered. The data stays in memory until the
+ * buffer fills up or the transfer ends, so the disk sees a few large writes
+ * instead of one per recv(). */
+static gboolean dcc_flush_recv(struct DCC *dcc) {
+  int pos = 0, n;
+
+  if (dcc->checksum)
+    g_checksum_update(dcc->checksum, (guchar *)dcc->recvbuf,
+                      dcc->recvbuf_used);
+
+  while (pos < dcc->recvbuf_used) {
+    n = write(dcc->fp, dcc->recvbuf + pos, dcc->recvbuf_used - pos);
+    if (n == 0 || (n < 0 && errno != EINTR)) {
+      dcc->recvbuf_used = 0;
+      return FALSE;
+    }
+    if (n > 0)
+      pos += n;
+  }
+
+  dcc->recvbuf_used = 0;
+  return TRUE;
+}
+
+/* A resumed receive is hashed from the part already on disk first, then
+ * goes on like a fresh one. */
+static GChecksum *dcc_checksum_existing(const char *filename, guint64 len) {
+  GChecksum *checksum;
+  char *buf;
+  gssize n;
+  int fd;
+
+  fd = g_open(filename, O_RDONLY | OFLAGS, 0);
+  if (fd == -1)
+    return NULL;
+
+  checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  buf = g_malloc(65536);
+  while (len > 0) {
+    n = read(fd, buf, MIN(len, 65536));
+    if (n < 1) {
+      g_clear_pointer(&checksum, g_checksum_free);
+      break;
+    }
+    g_checksum_update(checksum, (guchar *)buf, n);
+    len -= n;
+  }
+  g_free(buf);
+  close(fd);
+
+  return checksum;
+}
+
 static gboolean dcc_read(GIOChannel *source, GIOCondition condition,
                          struct DCC *dcc) {
   char *old;
   char buf[4096];
   int n;
   gboolean need_ack = FALSE;
+  gboolean done;
 
   if (dcc->fp == -1) {
 
@@ -594,6 +666,10 @@ static gboolean dcc_read(GIOChannel *source, GIOCondition condition,
       gchar *filename_fs =
           g_filename_from_utf8(dcc->destfile, -1, NULL, NULL, NULL);
       dcc->fp = g_open(dcc->destfile, O_WRONLY | O_APPEND | OFLAGS, 0);
+
+      g_clear_pointer(&dcc->sha256, g_free);
+      if (dcc->fp != -1 && plugin_print_hooked("DCC RECV Complete"))
+        dcc->checksum = dcc_checksum_existing(filename_fs, dcc->resumable);
       g_free(filename_fs);
 
       dcc->pos = dcc->resumable;
@@ -620,6 +696,12 @@ static gboolean dcc_read(GIOChannel *source, GIOCondition condition,
       dcc->fp = g_open(filename_fs, OFLAGS | O_TRUNC | O_WRONLY | O_CREAT,
                        prefs.hex_dcc_permissions);
       g_free(filename_fs);
+
+      /* hash the file as it's written, so plugins like checksum don't have
+       * to read it back afterwards */
+      g_clear_pointer(&dcc->sha256, g_free);
+      if (dcc->fp != -1 && plugin_print_hooked("DCC RECV Complete"))
+        dcc->checksum = g_checksum_new(G_CHECKSUM_SHA256);
     }
   }
   if (dcc->fp == -1) {
@@ -629,6 +711,14 @@ static gboolean dcc_read(GIOChannel *source, GIOCondition condition,
     dcc_close(dcc, STAT_FAILED, FALSE);
     return TRUE;
   }
+  if (!dcc->recvbuf) {
+    dcc->recvbuf_size = DCC_RECV_BUFSIZE;
+    if (dcc->size > dcc->pos)
+      dcc->recvbuf_size = MIN(dcc->recvbuf_size, dcc->size - dcc->pos);
+    dcc->recvbuf_size = MAX(dcc->recvbuf_size, DCC_RECV_MINBUFSIZE);
+    dcc->recvbuf = g_malloc(dcc->recvbuf_size);
+  }
+
   while (1) {
     if (dcc->throttled) {
       if (need_ack)
@@ -642,7 +732,8 @@ static gboolean dcc_read(GIOChannel *source, GIOCondition condition,
     if (!dcc->iotag)
       dcc->iotag = fe_input_add(dcc->sok, FIA_READ | FIA_EX, dcc_read, dcc);
 
-    n = recv(dcc->sok, buf, sizeof(buf), 0);
+    n = recv(dcc->sok, dcc->recvbuf + dcc->recvbuf_used,
+             dcc->recvbuf_size - dcc->recvbuf_used, 0);
     if (n < 1) {
       if (n < 0) {
         if (would_block()) {
@@ -661,21 +752,24 @@ static gboolean dcc_read(GIOChannel *source, GIOCondition condition,
       return TRUE;
     }
 
-    if (write(dcc->fp, buf, n) == -1) /* could be out of hdd space */
+    dcc->recvbuf_used += n;
+    dcc->lasttime = time(0);
+    dcc->pos += n;
+    need_ack = TRUE; /* send ack when we're done recv()ing */
+
+    done = dcc->pos >= dcc->size;
+    if ((done || dcc->recvbuf_used == dcc->recvbuf_size) &&
+        !dcc_flush_recv(dcc)) /* could be out of hdd space */
     {
       EMIT_SIGNAL(XP_TE_DCCRECVERR, dcc->serv->front_session, dcc->file,
                   dcc->destfile, dcc->nick, errorstring(errno), 0);
-      if (need_ack)
-        dcc_send_ack(dcc);
       dcc_close(dcc, STAT_FAILED, FALSE);
       return TRUE;
     }
 
-    dcc->lasttime = time(0);
-    dcc->pos += n;
-    need_ack = TRUE; /* send ack when we're done recv()ing */
-
-    if (dcc->pos >= dcc->size) {
+    if (done) {
+      if (dcc->checksum)
+        dcc->sha256 = g_strdup(g_checksum_get_string(dcc->checksum));
       dcc_send_ack(dcc);
       dcc_close(dcc, STAT_DONE, FALSE);
       dcc_calc_average_cps(
@@ -1272,9 +1366,50 @@ static void dcc_connect(struct DCC *dcc) {
   fe_dcc_update(dcc);
 }
 
+#ifdef HAVE_SENDFILE
+/* Send straight from the file to the socket. Fastsend hands over as much as
+ * the socket buffer holds, otherwise one block per ack. Returns what send()
+ * would, or -2 to fall back to read()/send() for good. */
+static int dcc_sendfile(struct DCC *dcc) {
+  off_t offset = dcc->pos;
+  size_t len;
+  ssize_t sent;
+  int sndbuf;
+  socklen_t optlen = sizeof(sndbuf);
+
+  if (dcc->sendfile_len == 0) {
+    dcc->sendfile_len = prefs.hex_dcc_blocksize;
+    if (dcc->fastsend &&
+        getsockopt(dcc->sok, SOL_SOCKET, SO_SNDBUF, &sndbuf, &optlen) == 0 &&
+        sndbuf > dcc->sendfile_len)
+      dcc->sendfile_len = sndbuf;
+  }
+
+  if (dcc->sendfile_len < 0)
+    return -2;
+
+  len = MIN((guint64)dcc->sendfile_len, dcc->size - dcc->pos);
+  if (len == 0)
+    return 0;
+
+  sent = sendfile(dcc->sok, dcc->fp, &offset, len);
+  if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+    /* the file can't be mmapped, e.g. on some network filesystems */
+    dcc->sendfile_len = -1;
+    return -2;
+  }
+  if (sent == 0) { /* the file got shorter, abort the transfer */
+    errno = EIO;
+    return -1;
+  }
+
+  return sent;
+}
+#endif
+
 static gboolean dcc_send_data(GIOChannel *source, GIOCondition condition,
                               struct DCC *dcc) {
-  char *buf;
+  char *buf = NULL;
   int len, sent, sok = dcc->sok;
 
   if (prefs.hex_dcc_blocksize < 1) /* this is too little! */
@@ -1295,13 +1430,19 @@ static gboolean dcc_send_data(GIOChannel *source, GIOCondition condition,
   } else if (!dcc->wiotag)
     dcc->wiotag = fe_input_add(sok, FIA_WRITE, dcc_send_data, dcc);
 
-  buf = g_malloc(prefs.hex_dcc_blocksize);
+#ifdef HAVE_SENDFILE
+  sent = dcc_sendfile(dcc);
+  if (sent == -2)
+#endif
+  {
+    buf = g_malloc(prefs.hex_dcc_blocksize);
 
-  lseek(dcc->fp, dcc->pos, SEEK_SET);
-  len = read(dcc->fp, buf, prefs.hex_dcc_blocksize);
-  if (len < 1)
-    goto abortit;
-  sent = send(sok, buf, len, 0);
+    lseek(dcc->fp, dcc->pos, SEEK_SET);
+    len = read(dcc->fp, buf, prefs.hex_dcc_blocksize);
+    if (len < 1)
+      goto abortit;
+    sent = send(sok, buf, len, 0);
+  }
 
   if (sent < 0 && !(would_block())) {
   abortit:
@@ -58,6 +58,12 @@ struct DCC
 	gint64 cps;
 	int resume_error;
 	int resume_errno;
+	char *recvbuf;				/* received data not written to fp yet */
+	int recvbuf_used;
+	int recvbuf_size;
+	GChecksum *checksum;		/* SHA-256 of a receive so far, if a plugin wants it */
+	char *sha256;				/* the finished SHA-256, for the "dcc" plugin list */
+	int sendfile_len;			/* bytes per sendfile(), 0: not set up, -1: don't use it */
 
 	GTimeVal lastcpstv, firstcpstv;
 	goffset lastcpspos;
@@ -98,6 +98,7 @@ void fe_progressbar_end (struct server *serv);
 void fe_print_text (struct session *sess, char *text, time_t stamp,
 					gboolean no_activity);
 void fe_userlist_insert (struct session *sess, struct User *newuser, gboolean sel);
+void fe_userlist_insert_list (struct session *sess, GPtrArray *users);
 int fe_userlist_remove (struct session *sess, struct User *user);
 void fe_userlist_rehash (struct session *sess, struct User *user);
 void fe_userlist_update (struct session *sess, struct User *user);
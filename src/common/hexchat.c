@@ -32,6 +32,7 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <unistd.h>
+#include <glib-unix.h>
 #endif
 
 #include "hexchat.h"
@@ -205,24 +206,52 @@ find_dialog (server *serv, char *nick)
 	return NULL;
 }
 
+/* Found channels are cached in serv->channels. A tab's name changes in too
+   many places to keep the cache exact, so a hit is checked against the
+   session and a stale one falls back to searching sess_list. */
+
 session *
 find_channel (server *serv, char *chan)
 {
 	session *sess;
-	GSList *list = sess_list;
+	GSList *list;
+
+	if (serv->channels)
+	{
+		sess = g_hash_table_lookup (serv->channels, chan);
+		if (sess)
+		{
+			if (sess->type == SESS_CHANNEL && !serv->p_cmp (chan, sess->channel))
+				return sess;
+			g_hash_table_remove (serv->channels, chan);
+		}
+	}
+
+	list = sess_list;
 	while (list)
 	{
 		sess = list->data;
 		if ((serv == sess->server) && sess->type == SESS_CHANNEL)
 		{
 			if (!serv->p_cmp (chan, sess->channel))
+			{
+				if (!serv->channels)
+					serv->channels = casemap_hash_table_new (serv->p_cmp, g_free, NULL);
+				g_hash_table_insert (serv->channels, g_strdup (chan), sess);
 				return sess;
+			}
 		}
 		list = list->next;
 	}
 	return NULL;
 }
 
+static gboolean
+find_channel_forget_cb (gpointer key, gpointer value, gpointer sess)
+{
+	return value == sess;
+}
+
 static void
 lagcheck_update (void)
 {
@@ -664,6 +693,10 @@ session_free (session *killsess)
 	if (killsess->type == SESS_CHANNEL)
 		userlist_free (killsess);
 
+	if (killserv->channels)
+		g_hash_table_foreach_remove (killserv->channels, find_channel_forget_cb, killsess);
+	inbound_netsplit_forget (killsess);
+
 	oldidx = killsess->lastact_idx;
 	if (oldidx != LACT_NONE)
 		sess_list_by_lastact[oldidx] = g_list_remove(sess_list_by_lastact[oldidx], killsess);
@@ -792,6 +825,23 @@ sigusr2_handler (int signal, siginfo_t *si, void *un)
 }
 #endif
 
+#ifndef WIN32
+/* Write out everything held back by a flush timer (logs, url.log, plugin
+   preferences) before dying. This runs from the main loop, not the signal
+   handler, so it's safe to touch the sessions. */
+
+static gboolean
+sigterm_handler (gpointer data)
+{
+	log_flush_all ();
+	url_log_flush ();
+	pluginpref_flush ();
+	signal (SIGTERM, SIG_DFL);
+	raise (SIGTERM);
+	return FALSE;
+}
+#endif
+
 static gint
 xchat_auto_connect (gpointer userdata)
 {
@@ -840,6 +890,10 @@ xchat_init (void)
 #endif
 #endif
 
+#ifndef WIN32
+	g_unix_signal_add (SIGTERM, sigterm_handler, NULL);
+#endif
+
 	load_text_events ();
 	sound_load ();
 	notify_load ();
@@ -996,6 +1050,7 @@ hexchat_exit (void)
 	sound_save ();
 	notify_save ();
 	ignore_save ();
+	url_log_flush ();
 	free_sessions ();
 	chanopt_save_all (TRUE);
 	servlist_cleanup ();
@@ -178,6 +178,7 @@ struct hexchatprefs {
   unsigned int hex_irc_hide_version;
   unsigned int hex_irc_invisible;
   unsigned int hex_irc_logging;
+  unsigned int hex_irc_netsplit_summary;
   unsigned int hex_irc_raw_modes;
   unsigned int hex_irc_servernotice;
   unsigned int hex_irc_skip_motd;
@@ -351,7 +352,8 @@ typedef enum gtk_xtext_search_flags_e {
   backward = 2,
   highlight = 4,
   follow = 8,
-  regexp = 16
+  regexp = 16,
+  all_tabs = 32 /* lastlog only: every tab of the server */
 } gtk_xtext_search_flags;
 
 typedef enum {
@@ -377,6 +379,8 @@ typedef struct session {
 
   struct server *server;
   tree *usertree;  /* alphabetical tree */
+  GHashTable *userhash; /* nick -> struct User, same users as usertree */
+  GPtrArray *names_pending; /* NAMES users not in usertree yet */
   struct User *me; /* points to myself in the usertree */
   char channel[CHANLEN];
   char waitchannel[CHANLEN];     /* waiting to join channel (/join sent) */
@@ -385,9 +389,14 @@ typedef struct session {
   char channelkey[64];        /* XXX correct max length? */
   int limit;                  /* channel user limit */
   int logfd;
+  char *logpath;   /* file logfd was opened on */
+  time_t logcheck; /* when to check logpath again */
+  GString *logbuf; /* log lines not written to logfd yet */
 
-  GFile *scrollfile; /* scrollback file */
+  GFile *scrollfile;           /* scrollback file */
+  GOutputStream *scrollstream; /* append handle on scrollfile */
   int scrollwritten; /* number of lines written */
+  int scrollsegment; /* lines in the current segment of scrollfile */
 
   char lastnick[NICKLEN]; /* last nick you /msg'ed */
 
@@ -498,6 +507,9 @@ typedef struct server {
 #endif
   int childread;
   int childwrite;
+  GCancellable *resolving; /* looking up hostname before the child starts */
+  GPtrArray *resolved; /* struct sockaddr_storage for server_child, NULL: it resolves */
+  char *resolved_ip;   /* the first of them, as text */
   int childpid;
   int iotag;
   int recondelay_tag;   /* reconnect delay timeout */
@@ -509,7 +521,7 @@ typedef struct server {
   char linebuf[8704]; /* RFC says 512 chars including \r\n, IRCv3 message tags
                          add 8191, plus the NUL byte */
   char *last_away_reason;
-  int pos; /* current position in linebuf */
+  int pos; /* length of the partial line at the start of linebuf */
   int nickcount;
   int loginmethod; /* see login_types[] */
 
@@ -522,6 +534,11 @@ typedef struct server {
 
   void *network; /* points to entry in servlist.c or NULL! */
 
+  GHashTable *user_sessions; /* nick -> GPtrArray of channels the nick is in */
+  GHashTable *channels; /* name -> session, find_channel() cache */
+  struct netsplit *netsplit; /* inbound.c: split/rejoin bursts being batched */
+  struct notify_ison *ison;  /* notify.c: ISON batches of this round */
+
   GSList *outbound_queue;
   time_t next_send; /* cptr->since in ircu */
   time_t prev_now;  /* previous now-time */
@@ -562,6 +579,7 @@ typedef struct server {
   unsigned int doing_dns : 1;    /* /dns has been done */
   unsigned int end_of_motd : 1;  /* end of motd reached (logged in) */
   unsigned int sent_quit : 1;    /* sent a QUIT already? */
+  unsigned int linebuf_skip : 1; /* dropping the tail of an overlong line */
   unsigned int use_listargs : 1; /* undernet and dalnet need /list >0,<10000 */
   unsigned int is_away : 1;
   unsigned int reconnect_away : 1;   /* whether to reconnect in is_away state */
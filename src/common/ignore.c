@@ -46,6 +46,150 @@ int ignored_noti = 0;
 int ignored_invi = 0;
 static int ignored_total = 0;
 
+/* ignore_check() doesn't walk ignore_list, it looks masks up in an index
+ * built from it:
+ *   - masks without wildcards in a hash table,
+ *   - masks with a literal start ("nick!*@*") in a trie of that start,
+ *   - masks with a literal end ("*!*@host") in a trie of that end, reversed,
+ *   - anything else ("*!ident@*", escapes) on a plain list.
+ * Each lookup only gives candidates, match() still has the final say.
+ */
+
+struct ignore_trie
+{
+	struct ignore_trie *child;	/* first node one character further */
+	struct ignore_trie *next;	/* sibling, same depth */
+	GSList *ignores;				/* masks whose literal part ends here */
+	unsigned char c;				/* rfc_tolower'd */
+};
+
+static GHashTable *ignore_exact = NULL;
+static struct ignore_trie *ignore_prefix = NULL;
+static struct ignore_trie *ignore_suffix = NULL;
+static GSList *ignore_other = NULL;
+static int ignore_unignores = 0;
+static gboolean ignore_index_dirty = TRUE;
+
+static struct ignore_trie *
+ignore_trie_child (struct ignore_trie *node, unsigned char c, gboolean create)
+{
+	struct ignore_trie *child;
+
+	for (child = node->child; child; child = child->next)
+	{
+		if (child->c == c)
+			return child;
+	}
+
+	if (!create)
+		return NULL;
+
+	child = g_new0 (struct ignore_trie, 1);
+	child->c = c;
+	child->next = node->child;
+	node->child = child;
+	return child;
+}
+
+/* step is 1 to add str[0..len) or -1 to add it backwards from str[len - 1] */
+
+static void
+ignore_trie_add (struct ignore_trie *node, const char *str, int len, int step,
+					  struct ignore *ig)
+{
+	const char *p = (step > 0) ? str : str + len - 1;
+
+	while (len--)
+	{
+		node = ignore_trie_child (node, rfc_tolower (*p), TRUE);
+		p += step;
+	}
+
+	node->ignores = g_slist_prepend (node->ignores, ig);
+}
+
+static void
+ignore_trie_free (struct ignore_trie *node)
+{
+	struct ignore_trie *next;
+
+	while (node)
+	{
+		next = node->next;
+		ignore_trie_free (node->child);
+		g_slist_free (node->ignores);
+		g_free (node);
+		node = next;
+	}
+}
+
+static void
+ignore_index_add (struct ignore *ig)
+{
+	const char *first, *last;
+	int prefix_len, suffix_len;
+
+	if (ig->type & IG_UNIG)
+		ignore_unignores++;
+
+	/* escaped wildcards aren't worth taking apart */
+	if (strchr (ig->mask, '\\'))
+	{
+		ignore_other = g_slist_prepend (ignore_other, ig);
+		return;
+	}
+
+	first = strpbrk (ig->mask, "*?");
+	if (!first)
+	{
+		/* a duplicate can only come from a hand-edited ignore.conf */
+		if (g_hash_table_contains (ignore_exact, ig->mask))
+			ignore_other = g_slist_prepend (ignore_other, ig);
+		else
+			g_hash_table_insert (ignore_exact, ig->mask, ig);
+		return;
+	}
+
+	/* just past the last wildcard */
+	last = ig->mask + strlen (ig->mask);
+	while (last[-1] != '*' && last[-1] != '?')
+		last--;
+
+	prefix_len = first - ig->mask;
+	suffix_len = strlen (last);
+
+	if (prefix_len && prefix_len >= suffix_len)
+		ignore_trie_add (ignore_prefix, ig->mask, prefix_len, 1, ig);
+	else if (suffix_len)
+		ignore_trie_add (ignore_suffix, last, suffix_len, -1, ig);
+	else
+		ignore_other = g_slist_prepend (ignore_other, ig);
+}
+
+static void
+ignore_index_build (void)
+{
+	GSList *list;
+
+	if (ignore_exact)
+		g_hash_table_remove_all (ignore_exact);
+	else
+		ignore_exact = casemap_hash_table_new (rfc_casecmp, NULL, NULL);
+
+	ignore_trie_free (ignore_prefix);
+	ignore_trie_free (ignore_suffix);
+	ignore_prefix = g_new0 (struct ignore_trie, 1);
+	ignore_suffix = g_new0 (struct ignore_trie, 1);
+	g_slist_free (ignore_other);
+	ignore_other = NULL;
+	ignore_unignores = 0;
+
+	for (list = ignore_list; list; list = list->next)
+		ignore_index_add (list->data);
+
+	ignore_index_dirty = FALSE;
+}
+
 /* ignore_exists ():
  * returns: struct ig, if this mask is in the ignore list already
  *          NULL, otherwise
@@ -89,6 +233,8 @@ ignore_add (char *mask, int type, gboolean overwrite)
 
 	if (!change_only)
 		ig = g_new (struct ignore, 1);
+	else
+		g_free (ig->mask);
 
 	ig->mask = g_strdup (mask);
 
@@ -99,6 +245,7 @@ ignore_add (char *mask, int type, gboolean overwrite)
 
 	if (!change_only)
 		ignore_list = g_slist_prepend (ignore_list, ig);
+	ignore_index_dirty = TRUE;
 	fe_ignore_update (1);
 
 	if (change_only)
@@ -189,6 +336,7 @@ ignore_del (char *mask, struct ignore *ig)
 	if (ig)
 	{
 		ignore_list = g_slist_remove (ignore_list, ig);
+		ignore_index_dirty = TRUE;
 		g_free (ig->mask);
 		g_free (ig);
 		fe_ignore_update (1);
@@ -197,59 +345,104 @@ ignore_del (char *mask, struct ignore *ig)
 	return FALSE;
 }
 
-/* check if a msg should be ignored by browsing our ignore list */
+/* returns TRUE once the answer is known: an unignore matched (*ignored is
+   cleared then), or an ignore matched and there are no unignores at all */
 
-int
-ignore_check (char *host, int type)
+static gboolean
+ignore_test (struct ignore *ig, char *host, int type, gboolean *ignored)
 {
-	struct ignore *ig;
-	GSList *list = ignore_list;
+	if (!(ig->type & type))
+		return FALSE;
 
-	/* check if there's an UNIGNORE first, they take precendance. */
-	while (list)
+	/* already ignored, only an unignore can change that */
+	if (*ignored && !(ig->type & IG_UNIG))
+		return FALSE;
+
+	if (!match (ig->mask, host))
+		return FALSE;
+
+	if (ig->type & IG_UNIG)
 	{
-		ig = (struct ignore *) list->data;
-		if (ig->type & IG_UNIG)
-		{
-			if (ig->type & type)
-			{
-				if (match (ig->mask, host))
-					return FALSE;
-			}
-		}
-		list = list->next;
+		*ignored = FALSE;
+		return TRUE;
 	}
 
-	list = ignore_list;
-	while (list)
-	{
-		ig = (struct ignore *) list->data;
+	*ignored = TRUE;
+	return !ignore_unignores;
+}
 
-		if (ig->type & type)
-		{
-			if (match (ig->mask, host))
-			{
-				ignored_total++;
-				if (type & IG_PRIV)
-					ignored_priv++;
-				if (type & IG_NOTI)
-					ignored_noti++;
-				if (type & IG_CHAN)
-					ignored_chan++;
-				if (type & IG_CTCP)
-					ignored_ctcp++;
-				if (type & IG_INVI)
-					ignored_invi++;
-				fe_ignore_update (2);
-				return TRUE;
-			}
-		}
-		list = list->next;
+static gboolean
+ignore_test_list (GSList *list, char *host, int type, gboolean *ignored)
+{
+	for (; list; list = list->next)
+	{
+		if (ignore_test (list->data, host, type, ignored))
+			return TRUE;
 	}
+	return FALSE;
+}
+
+/* walks the trie along host, forwards or backwards, testing every mask
+   whose literal part was passed */
 
+static gboolean
+ignore_test_trie (struct ignore_trie *node, char *host, int step, int type,
+						gboolean *ignored)
+{
+	int len = strlen (host);
+	char *p = (step > 0) ? host : host + len - 1;
+
+	while (len--)
+	{
+		node = ignore_trie_child (node, rfc_tolower (*p), FALSE);
+		if (!node)
+			break;
+		if (ignore_test_list (node->ignores, host, type, ignored))
+			return TRUE;
+		p += step;
+	}
 	return FALSE;
 }
 
+/* check if a msg should be ignored by looking it up in our ignore list,
+   UNIGNOREs take precedence */
+
+int
+ignore_check (char *host, int type)
+{
+	struct ignore *ig;
+	gboolean ignored = FALSE;
+
+	if (!ignore_list)
+		return FALSE;
+
+	if (ignore_index_dirty)
+		ignore_index_build ();
+
+	ig = g_hash_table_lookup (ignore_exact, host);
+	if (!ig || !ignore_test (ig, host, type, &ignored))
+		if (!ignore_test_trie (ignore_prefix, host, 1, type, &ignored))
+			if (!ignore_test_trie (ignore_suffix, host, -1, type, &ignored))
+				ignore_test_list (ignore_other, host, type, &ignored);
+
+	if (!ignored)
+		return FALSE;
+
+	ignored_total++;
+	if (type & IG_PRIV)
+		ignored_priv++;
+	if (type & IG_NOTI)
+		ignored_noti++;
+	if (type & IG_CHAN)
+		ignored_chan++;
+	if (type & IG_CTCP)
+		ignored_ctcp++;
+	if (type & IG_INVI)
+		ignored_invi++;
+	fe_ignore_update (2);
+	return TRUE;
+}
+
 static char *
 ignore_read_next_entry (char *my_cfg, struct ignore *ignore)
 {
@@ -298,6 +491,7 @@ ignore_load ()
 					g_free (ignore);
 			}
 			g_free (cfg);
+			ignore_index_dirty = TRUE;
 		}
 		close (fh);
 	}
@@ -42,6 +42,7 @@
 #include "notify.h"
 #include "outbound.h"
 #include "inbound.h"
+#include "plugin.h"
 #include "server.h"
 #include "servlist.h"
 #include "text.h"
@@ -81,9 +82,7 @@ void set_topic(session *sess, char *topic, char *stripped_topic) {
     char tbuf[1024];
     g_snprintf(tbuf, sizeof(tbuf), "[%s has address %s]\n", sess->channel,
                stripped_topic);
-    if (write(sess->logfd, tbuf, strlen(tbuf)) < 0) {
-      /* handle error if necessary */
-    }
+    log_append(sess, tbuf, -1);
   }
 
   g_free(sess->topic);
@@ -228,14 +227,16 @@ gboolean alert_match_word(char *word, char *masks) {
   }
 }
 
-gboolean alert_match_text(char *text, char *masks) {
-  unsigned char *p = text;
+/* calls cb for each word of text until it returns TRUE. A word is made of
+   letters, digits and the RFC1459 <special> chars that can be in a nick. */
+
+static gboolean alert_foreach_word(char *text,
+                                   gboolean (*cb)(char *word, gpointer data),
+                                   gpointer data) {
+  unsigned char *p = (unsigned char *)text;
   unsigned char endchar;
   int res;
 
-  if (masks[0] == 0)
-    return FALSE;
-
   while (1) {
     if (*p >= '0' && *p <= '9') {
       p++;
@@ -261,16 +262,18 @@ gboolean alert_match_text(char *text, char *masks) {
     /* if it's a 0, space or comma, the word has ended. */
     if (*p == 0 || *p == ' ' || *p == ',' ||
         /* if it's anything BUT a letter, the word has ended. */
-        (!g_unichar_isalpha(g_utf8_get_char(p)))) {
-      endchar = *p;
-      *p = 0;
-      res = alert_match_word(text, masks);
-      *p = endchar;
-
-      if (res)
-        return TRUE; /* yes, matched! */
+        (!g_unichar_isalpha(g_utf8_get_char((char *)p)))) {
+      if ((char *)p != text) {
+        endchar = *p;
+        *p = 0;
+        res = cb(text, data);
+        *p = endchar;
+
+        if (res)
+          return TRUE; /* yes, matched! */
+      }
 
-      text = p + g_utf8_skip[p[0]];
+      text = (char *)p + g_utf8_skip[p[0]];
       if (*p == 0)
         return FALSE;
     }
@@ -279,16 +282,113 @@ gboolean alert_match_text(char *text, char *masks) {
   }
 }
 
+static gboolean alert_match_word_cb(char *word, gpointer masks) {
+  return alert_match_word(word, masks);
+}
+
+gboolean alert_match_text(char *text, char *masks) {
+  if (masks[0] == 0)
+    return FALSE;
+
+  return alert_foreach_word(text, alert_match_word_cb, masks);
+}
+
+/* A highlight pref compiled for is_hilight(): plain words go in a casemapped
+   hash set, masks with wildcards are left for match(). It's rebuilt whenever
+   the pref string differs from the one it was built from. */
+
+typedef struct {
+  char *source;
+  GHashTable *words;
+  GSList *masks;
+} hilight_list;
+
+static hilight_list hilight_extra;
+static hilight_list hilight_nicks;
+static hilight_list hilight_ignore;
+
+static void hilight_list_update(hilight_list *hl, const char *pref) {
+  char **tokens;
+  int i;
+
+  if (hl->source && strcmp(hl->source, pref) == 0)
+    return;
+
+  g_free(hl->source);
+  hl->source = g_strdup(pref);
+  if (hl->words)
+    g_hash_table_remove_all(hl->words);
+  else
+    hl->words = casemap_hash_table_new(rfc_casecmp, g_free, NULL);
+  g_slist_free_full(hl->masks, g_free);
+  hl->masks = NULL;
+
+  /* same separators as alert_match_word() */
+  tokens = g_strsplit_set(pref, ", ", -1);
+  for (i = 0; tokens[i]; i++) {
+    if (tokens[i][0] == 0)
+      continue;
+
+    if (strpbrk(tokens[i], "*?\\"))
+      hl->masks = g_slist_prepend(hl->masks, tokens[i]);
+    else
+      g_hash_table_add(hl->words, tokens[i]);
+  }
+  g_free(tokens); /* the strings moved into hl */
+}
+
+static gboolean hilight_list_match(char *word, gpointer data) {
+  hilight_list *hl = data;
+  GSList *list;
+
+  if (g_hash_table_contains(hl->words, word))
+    return TRUE;
+
+  for (list = hl->masks; list; list = list->next) {
+    if (match(list->data, word))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean hilight_word_cb(char *word, gpointer serv) {
+  char *nick = ((server *)serv)->nick;
+
+  if (nick[0] && rfc_casecmp(nick, word) == 0)
+    return TRUE;
+
+  return hilight_list_match(word, &hilight_extra);
+}
+
 static int is_hilight(char *from, char *text, session *sess, server *serv) {
-  if (alert_match_word(from, prefs.hex_irc_no_hilight))
+  char buf[512];
+  char *stripped;
+  int len, res;
+
+  hilight_list_update(&hilight_ignore, prefs.hex_irc_no_hilight);
+  if (hilight_list_match(from, &hilight_ignore))
     return 0;
 
-  text = strip_color(text, -1, STRIP_ALL);
+  hilight_list_update(&hilight_nicks, prefs.hex_irc_nick_hilight);
+  res = hilight_list_match(from, &hilight_nicks);
+
+  if (!res) {
+    /* one pass over the words of the stripped text, on the stack when
+       it fits */
+    hilight_list_update(&hilight_extra, prefs.hex_irc_extra_hilight);
+
+    len = strlen(text);
+    stripped = (len + 2 <= (int)sizeof(buf)) ? buf : g_malloc(len + 2);
+    strip_color2(text, len, stripped, STRIP_ALL);
 
-  if (alert_match_text(text, serv->nick) ||
-      alert_match_text(text, prefs.hex_irc_extra_hilight) ||
-      alert_match_word(from, prefs.hex_irc_nick_hilight)) {
-    g_free(text);
+    res = alert_foreach_word(stripped, hilight_word_cb, serv);
+
+    if (stripped != buf)
+      g_free(stripped);
+  }
+
+  if (res) {
     if (sess != current_tab) {
       sess->tab_state |= TAB_STATE_NEW_HILIGHT;
       lastact_update(sess);
@@ -296,7 +396,6 @@ static int is_hilight(char *from, char *text, session *sess, server *serv) {
     return 1;
   }
 
-  g_free(text);
   return 0;
 }
 
@@ -438,38 +537,58 @@ void inbound_chanmsg(server *serv, session *sess, char *chan, char *from,
                           tags_data->timestamp);
 }
 
+static void inbound_newnick_sess(session *sess, char *nick, char *newnick,
+                                 int me, int quiet,
+                                 const message_tags_data *tags_data) {
+  server *serv = sess->server;
+
+  if (userlist_change(sess, nick, newnick) ||
+      (me && sess->type == SESS_SERVER)) {
+    if (!quiet) {
+      if (me)
+        EMIT_SIGNAL_TIMESTAMP(XP_TE_UCHANGENICK, sess, nick, newnick, NULL,
+                              NULL, 0, tags_data->timestamp);
+      else
+        EMIT_SIGNAL_TIMESTAMP(XP_TE_CHANGENICK, sess, nick, newnick, NULL,
+                              NULL, 0, tags_data->timestamp);
+    }
+  }
+  if (sess->type == SESS_DIALOG && !serv->p_cmp(sess->channel, nick)) {
+    safe_strcpy(sess->channel, newnick, CHANLEN);
+    sess->logcheck = 0; /* log to the new nick's file */
+    fe_set_channel(sess);
+  }
+  fe_set_title(sess);
+}
+
 void inbound_newnick(server *serv, char *nick, char *newnick, int quiet,
                      const message_tags_data *tags_data) {
   int me = FALSE;
   session *sess;
-  GSList *list = sess_list;
+  GSList *list, *sessions;
 
   if (!serv->p_cmp(nick, serv->nick)) {
     me = TRUE;
     safe_strcpy(serv->nick, newnick, NICKLEN);
   }
 
-  while (list) {
-    sess = list->data;
-    if (sess->server == serv) {
-      if (userlist_change(sess, nick, newnick) ||
-          (me && sess->type == SESS_SERVER)) {
-        if (!quiet) {
-          if (me)
-            EMIT_SIGNAL_TIMESTAMP(XP_TE_UCHANGENICK, sess, nick, newnick, NULL,
-                                  NULL, 0, tags_data->timestamp);
-          else
-            EMIT_SIGNAL_TIMESTAMP(XP_TE_CHANGENICK, sess, nick, newnick, NULL,
-                                  NULL, 0, tags_data->timestamp);
-        }
-      }
-      if (sess->type == SESS_DIALOG && !serv->p_cmp(sess->channel, nick)) {
-        safe_strcpy(sess->channel, newnick, CHANLEN);
-        fe_set_channel(sess);
-      }
-      fe_set_title(sess);
+  if (me) {
+    /* every title shows our nick */
+    for (list = sess_list; list; list = list->next) {
+      sess = list->data;
+      if (sess->server == serv)
+        inbound_newnick_sess(sess, nick, newnick, me, quiet, tags_data);
     }
-    list = list->next;
+  } else {
+    /* only the channels we share and the dialog change */
+    sessions = userlist_find_sessions(serv, nick);
+    sess = find_dialog(serv, nick);
+    if (sess)
+      sessions = g_slist_prepend(sessions, sess);
+
+    for (list = sessions; list; list = list->next)
+      inbound_newnick_sess(list->data, nick, newnick, me, quiet, tags_data);
+    g_slist_free(sessions);
   }
 
   dcc_change_nick(serv, nick, newnick);
@@ -640,7 +759,7 @@ void inbound_nameslist(server *serv, char *chan, char *names,
 
     g_strlcpy(name, name_list[i], MIN(offset, sizeof(name)));
 
-    userlist_add(sess, name, host, NULL, NULL, tags_data);
+    userlist_add_names(sess, name, host);
   }
   g_strfreev(name_list);
 }
@@ -676,12 +795,251 @@ void inbound_topicnew(server *serv, char *nick, char *chan, char *topic,
   }
 }
 
+/* Netsplits, and the netjoins after them, are shown as one line per
+   channel: the nicks of a burst are collected for a second and then
+   printed together. */
+
+#define NETSPLIT_DELAY 1      /* seconds a burst is collected for */
+#define NETSPLIT_MAX_NICKS 15 /* nicks named in one summary */
+#define NETSPLIT_REMEMBER 900 /* seconds a split nick's join is a netjoin */
+
+struct netsplit_batch {
+  GString *nicks;
+  int count;
+  char *servers;    /* "hub <-> leaf", netsplits only */
+  time_t timestamp; /* server-time of the first nick in the batch */
+};
+
+struct netsplit {
+  GHashTable *quits;       /* session -> struct netsplit_batch */
+  GHashTable *joins;       /* session -> struct netsplit_batch */
+  GHashTable *split_nicks; /* nick -> time it was split off */
+  GPtrArray *rejoined;     /* split nicks seen back during this burst */
+  int tag;
+};
+
+static gboolean inbound_is_hostname(const char *name, gsize len) {
+  gboolean dot = FALSE;
+  gsize i;
+
+  if (len == 0 || name[0] == '.' || name[len - 1] == '.')
+    return FALSE;
+
+  for (i = 0; i < len; i++) {
+    if (name[i] == '.')
+      dot = TRUE;
+    else if (!g_ascii_isalnum(name[i]) && name[i] != '-' && name[i] != '*')
+      return FALSE;
+  }
+  return dot;
+}
+
+/* servers give "hub.example.net leaf.example.net" as the reason */
+static gboolean inbound_is_netsplit(const char *reason) {
+  const char *space = strchr(reason, ' ');
+
+  if (!space)
+    return FALSE;
+  return inbound_is_hostname(reason, space - reason) &&
+         inbound_is_hostname(space + 1, strlen(space + 1));
+}
+
+static void netsplit_batch_free(struct netsplit_batch *batch) {
+  g_string_free(batch->nicks, TRUE);
+  g_free(batch->servers);
+  g_free(batch);
+}
+
+static struct netsplit *netsplit_get(server *serv) {
+  struct netsplit *ns = serv->netsplit;
+
+  if (!ns) {
+    ns = g_new0(struct netsplit, 1);
+    ns->quits = g_hash_table_new_full(NULL, NULL, NULL,
+                                      (GDestroyNotify)netsplit_batch_free);
+    ns->joins = g_hash_table_new_full(NULL, NULL, NULL,
+                                      (GDestroyNotify)netsplit_batch_free);
+    ns->split_nicks = casemap_hash_table_new(serv->p_cmp, g_free, NULL);
+    ns->rejoined = g_ptr_array_new_with_free_func(g_free);
+    serv->netsplit = ns;
+  }
+  return ns;
+}
+
+static void netsplit_emit(GHashTable *batches, int event) {
+  GList *sessions, *list;
+  struct netsplit_batch *batch;
+  session *sess;
+  char count[16];
+
+  /* printing can run plugins that close tabs, don't iterate the table */
+  sessions = g_hash_table_get_keys(batches);
+  for (list = sessions; list; list = list->next) {
+    sess = list->data;
+    batch = g_hash_table_lookup(batches, sess);
+    if (!batch)
+      continue;
+    g_hash_table_steal(batches, sess);
+
+    if (batch->count > NETSPLIT_MAX_NICKS)
+      g_string_append(batch->nicks, ", ...");
+    g_snprintf(count, sizeof(count), "%d", batch->count);
+
+    if (event == XP_TE_NETSPLIT)
+      EMIT_SIGNAL_TIMESTAMP(XP_TE_NETSPLIT, sess, batch->servers,
+                            batch->nicks->str, count, NULL, 0,
+                            batch->timestamp);
+    else
+      EMIT_SIGNAL_TIMESTAMP(XP_TE_NETJOIN, sess, batch->nicks->str, count,
+                            NULL, NULL, 0, batch->timestamp);
+    netsplit_batch_free(batch);
+  }
+  g_list_free(sessions);
+}
+
+static gboolean netsplit_expired(gpointer key, gpointer value, gpointer now) {
+  return *(guint *)now - GPOINTER_TO_UINT(value) > NETSPLIT_REMEMBER;
+}
+
+static int netsplit_timeout(server *serv) {
+  struct netsplit *ns = serv->netsplit;
+  guint now = time(NULL);
+  guint i;
+
+  ns->tag = 0;
+  netsplit_emit(ns->quits, XP_TE_NETSPLIT);
+  netsplit_emit(ns->joins, XP_TE_NETJOIN);
+
+  /* they're back, so their next join is an ordinary one */
+  for (i = 0; i < ns->rejoined->len; i++)
+    g_hash_table_remove(ns->split_nicks, ns->rejoined->pdata[i]);
+  g_ptr_array_set_size(ns->rejoined, 0);
+
+  g_hash_table_foreach_remove(ns->split_nicks, netsplit_expired, &now);
+  return 0;
+}
+
+static void netsplit_schedule(server *serv) {
+  struct netsplit *ns = serv->netsplit;
+
+  if (!ns->tag)
+    ns->tag = fe_timeout_add_seconds(NETSPLIT_DELAY, netsplit_timeout, serv);
+}
+
+static void netsplit_add(server *serv, session *sess, gboolean join,
+                         const char *nick, const char *reason,
+                         time_t timestamp) {
+  struct netsplit *ns = netsplit_get(serv);
+  GHashTable *batches = join ? ns->joins : ns->quits;
+  struct netsplit_batch *batch;
+  const char *space;
+
+  batch = g_hash_table_lookup(batches, sess);
+  if (!batch) {
+    batch = g_new0(struct netsplit_batch, 1);
+    batch->nicks = g_string_new(NULL);
+    batch->timestamp = timestamp;
+    if (reason) {
+      space = strchr(reason, ' ');
+      batch->servers = g_strdup_printf("%.*s <-> %s", (int)(space - reason),
+                                       reason, space + 1);
+    }
+    g_hash_table_insert(batches, sess, batch);
+  }
+
+  if (batch->count < NETSPLIT_MAX_NICKS) {
+    if (batch->nicks->len)
+      g_string_append(batch->nicks, ", ");
+    g_string_append(batch->nicks, nick);
+  }
+  batch->count++;
+
+  netsplit_schedule(serv);
+}
+
+/* Is this a nick coming back from a netsplit? If so it's forgotten once the
+   burst it came back in has been printed. Plugins hooking "Join" still get
+   one event per nick. */
+static gboolean netsplit_rejoin(server *serv, const char *nick) {
+  struct netsplit *ns = serv->netsplit;
+  gpointer value;
+
+  if (!prefs.hex_irc_netsplit_summary || !ns ||
+      !g_hash_table_lookup_extended(ns->split_nicks, nick, NULL, &value))
+    return FALSE;
+
+  if ((guint)time(NULL) - GPOINTER_TO_UINT(value) > NETSPLIT_REMEMBER ||
+      plugin_print_hooked("Join")) {
+    g_hash_table_remove(ns->split_nicks, nick);
+    return FALSE;
+  }
+
+  g_ptr_array_add(ns->rejoined, g_strdup(nick));
+  netsplit_schedule(serv);
+  return TRUE;
+}
+
+/* a nick that parts or quits normally isn't coming back from a split */
+static void netsplit_left(server *serv, const char *nick) {
+  if (serv->netsplit)
+    g_hash_table_remove(serv->netsplit->split_nicks, nick);
+}
+
+/* drop what's batched for a session that's being closed */
+void inbound_netsplit_forget(session *sess) {
+  struct netsplit *ns = sess->server ? sess->server->netsplit : NULL;
+
+  if (ns) {
+    g_hash_table_remove(ns->quits, sess);
+    g_hash_table_remove(ns->joins, sess);
+  }
+}
+
+/* CASEMAPPING changed, so the split nicks have to be hashed again */
+void inbound_netsplit_casemap(server *serv) {
+  struct netsplit *ns = serv->netsplit;
+  GHashTable *split_nicks;
+  GHashTableIter iter;
+  gpointer nick, value;
+
+  if (!ns)
+    return;
+
+  split_nicks = casemap_hash_table_new(serv->p_cmp, g_free, NULL);
+  g_hash_table_iter_init(&iter, ns->split_nicks);
+  while (g_hash_table_iter_next(&iter, &nick, &value)) {
+    g_hash_table_iter_steal(&iter);
+    g_hash_table_replace(split_nicks, nick, value);
+  }
+  g_hash_table_destroy(ns->split_nicks);
+  ns->split_nicks = split_nicks;
+}
+
+void inbound_netsplit_free(server *serv) {
+  struct netsplit *ns = serv->netsplit;
+
+  if (!ns)
+    return;
+
+  if (ns->tag)
+    fe_timeout_remove(ns->tag);
+  g_hash_table_destroy(ns->quits);
+  g_hash_table_destroy(ns->joins);
+  g_hash_table_destroy(ns->split_nicks);
+  g_ptr_array_free(ns->rejoined, TRUE);
+  g_free(ns);
+  serv->netsplit = NULL;
+}
+
 void inbound_join(server *serv, char *chan, char *user, char *ip, char *account,
                   char *realname, const message_tags_data *tags_data) {
   session *sess = find_channel(serv, chan);
   if (sess) {
-    EMIT_SIGNAL_TIMESTAMP(XP_TE_JOIN, sess, user, chan, ip, account, 0,
-                          tags_data->timestamp);
+    if (!netsplit_rejoin(serv, user))
+      EMIT_SIGNAL_TIMESTAMP(XP_TE_JOIN, sess, user, chan, ip, account, 0,
+                            tags_data->timestamp);
+    else if (!text_emit_hidden(XP_TE_NETJOIN, sess))
+      netsplit_add(serv, sess, TRUE, user, NULL, tags_data->timestamp);
     userlist_add(sess, user, ip, account, realname, tags_data);
   }
 }
@@ -708,6 +1066,7 @@ void inbound_part(server *serv, char *chan, char *user, char *ip, char *reason,
                             tags_data->timestamp);
     userlist_remove(sess, user);
   }
+  netsplit_left(serv, user);
 }
 
 void inbound_topictime(server *serv, char *chan, char *nick, time_t stamp,
@@ -727,44 +1086,48 @@ void inbound_topictime(server *serv, char *chan, char *nick, time_t stamp,
 
 void inbound_quit(server *serv, char *nick, char *ip, char *reason,
                   const message_tags_data *tags_data) {
-  GSList *list = sess_list;
+  GSList *list, *sessions;
   session *sess;
   struct User *user;
-  int was_on_front_session = FALSE;
+  int was_on_front_session;
+  gboolean netsplit;
 
-  while (list) {
-    sess = (session *)list->data;
-    if (sess->server == serv) {
-      if (sess == current_sess)
-        was_on_front_session = TRUE;
-      if ((user = userlist_find(sess, nick))) {
-        EMIT_SIGNAL_TIMESTAMP(XP_TE_QUIT, sess, nick, reason, ip, NULL, 0,
-                              tags_data->timestamp);
-        userlist_remove_user(sess, user);
-      } else if (sess->type == SESS_DIALOG &&
-                 !serv->p_cmp(sess->channel, nick)) {
+  was_on_front_session = current_sess && current_sess->server == serv;
+  /* plugins hooking "Quit" still get one event per nick */
+  netsplit = prefs.hex_irc_netsplit_summary && inbound_is_netsplit(reason) &&
+             !plugin_print_hooked("Quit");
+
+  sessions = userlist_find_sessions(serv, nick);
+  for (list = sessions; list; list = list->next) {
+    sess = list->data;
+    if ((user = userlist_find(sess, nick))) {
+      if (!netsplit)
         EMIT_SIGNAL_TIMESTAMP(XP_TE_QUIT, sess, nick, reason, ip, NULL, 0,
                               tags_data->timestamp);
-      }
+      else if (!text_emit_hidden(XP_TE_NETSPLIT, sess))
+        netsplit_add(serv, sess, FALSE, nick, reason, tags_data->timestamp);
+      userlist_remove_user(sess, user);
     }
-    list = list->next;
   }
+  g_slist_free(sessions);
+
+  if (netsplit)
+    g_hash_table_replace(netsplit_get(serv)->split_nicks, g_strdup(nick),
+                         GUINT_TO_POINTER((guint)time(NULL)));
+  else
+    netsplit_left(serv, nick);
+
+  sess = find_dialog(serv, nick);
+  if (sess)
+    EMIT_SIGNAL_TIMESTAMP(XP_TE_QUIT, sess, nick, reason, ip, NULL, 0,
+                          tags_data->timestamp);
 
   notify_set_offline(serv, nick, was_on_front_session, tags_data);
 }
 
 void inbound_account(server *serv, char *nick, char *account,
                      const message_tags_data *tags_data) {
-  session *sess = NULL;
-  GSList *list;
-
-  list = sess_list;
-  while (list) {
-    sess = list->data;
-    if (sess->server == serv)
-      userlist_set_account(sess, nick, account);
-    list = list->next;
-  }
+  userlist_set_account_global(serv, nick, account);
 }
 
 void inbound_ping_reply(session *sess, char *timestring, char *from,
@@ -910,7 +1273,6 @@ void inbound_away(server *serv, char *nick, char *msg,
                   const message_tags_data *tags_data) {
   struct away_msg *away = server_away_find_message(serv, nick);
   session *sess = NULL;
-  GSList *list;
 
   if (away && !strcmp(msg, away->message)) /* Seen the msg before? */
   {
@@ -934,35 +1296,22 @@ void inbound_away(server *serv, char *nick, char *msg,
     EMIT_SIGNAL_TIMESTAMP(XP_TE_WHOIS5, sess, nick, msg, NULL, NULL, 0,
                           tags_data->timestamp);
 
-  list = sess_list;
-  while (list) {
-    sess = list->data;
-    if (sess->server == serv)
-      userlist_set_away(sess, nick, TRUE);
-    list = list->next;
-  }
+  userlist_set_away_global(serv, nick, TRUE);
 }
 
 void inbound_away_notify(server *serv, char *nick, char *reason,
                          const message_tags_data *tags_data) {
-  session *sess = NULL;
-  GSList *list;
+  session *sess = serv->front_session;
 
-  list = sess_list;
-  while (list) {
-    sess = list->data;
-    if (sess->server == serv) {
-      userlist_set_away(sess, nick, reason ? TRUE : FALSE);
-      if (sess == serv->front_session && notify_is_in_list(serv, nick)) {
-        if (reason)
-          EMIT_SIGNAL_TIMESTAMP(XP_TE_NOTIFYAWAY, sess, nick, reason, NULL,
-                                NULL, 0, tags_data->timestamp);
-        else
-          EMIT_SIGNAL_TIMESTAMP(XP_TE_NOTIFYBACK, sess, nick, NULL, NULL, NULL,
-                                0, tags_data->timestamp);
-      }
-    }
-    list = list->next;
+  userlist_set_away_global(serv, nick, reason ? TRUE : FALSE);
+
+  if (sess && notify_is_in_list(serv, nick)) {
+    if (reason)
+      EMIT_SIGNAL_TIMESTAMP(XP_TE_NOTIFYAWAY, sess, nick, reason, NULL, NULL,
+                            0, tags_data->timestamp);
+    else
+      EMIT_SIGNAL_TIMESTAMP(XP_TE_NOTIFYBACK, sess, nick, NULL, NULL, NULL, 0,
+                            tags_data->timestamp);
   }
 }
 
@@ -978,6 +1327,7 @@ int inbound_nameslist_end(server *serv, char *chan,
       if (sess->server == serv) {
         sess->end_of_names = TRUE;
         sess->ignore_names = FALSE;
+        userlist_flush_names(sess, tags_data);
         fe_userlist_numbers(sess);
       }
       list = list->next;
@@ -988,6 +1338,7 @@ int inbound_nameslist_end(server *serv, char *chan,
   if (sess) {
     sess->end_of_names = TRUE;
     sess->ignore_names = FALSE;
+    userlist_flush_names(sess, tags_data);
     fe_userlist_numbers(sess);
     return TRUE;
   }
@@ -1209,26 +1560,12 @@ void inbound_login_start(session *sess, char *nick, char *servname,
   }
 }
 
-static void inbound_set_all_away_status(server *serv, char *nick,
-                                        unsigned int status) {
-  GSList *list;
-  session *sess;
-
-  list = sess_list;
-  while (list) {
-    sess = list->data;
-    if (sess->server == serv)
-      userlist_set_away(sess, nick, status);
-    list = list->next;
-  }
-}
-
 void inbound_uaway(server *serv, const message_tags_data *tags_data) {
   serv->is_away = TRUE;
   serv->away_time = time(NULL);
   fe_set_away(serv);
 
-  inbound_set_all_away_status(serv, serv->nick, 1);
+  userlist_set_away_global(serv, serv->nick, 1);
 }
 
 void inbound_uback(server *serv, const message_tags_data *tags_data) {
@@ -1236,7 +1573,7 @@ void inbound_uback(server *serv, const message_tags_data *tags_data) {
   serv->reconnect_away = FALSE;
   fe_set_away(serv);
 
-  inbound_set_all_away_status(serv, serv->nick, 0);
+  userlist_set_away_global(serv, serv->nick, 0);
 }
 
 void inbound_foundip(session *sess, char *ip,
@@ -1255,7 +1592,7 @@ void inbound_foundip(session *sess, char *ip,
 void inbound_user_info_start(session *sess, char *nick,
                              const message_tags_data *tags_data) {
   /* set away to FALSE now, 301 may turn it back on */
-  inbound_set_all_away_status(sess->server, nick, 0);
+  userlist_set_away_global(sess->server, nick, 0);
 }
 
 /* reporting new information found about this user. chan may be NULL.
@@ -25,6 +25,9 @@
 void inbound_next_nick (session *sess, char *nick, int error,
 								const message_tags_data *tags_data);
 void inbound_uback (server *serv, const message_tags_data *tags_data);
+void inbound_netsplit_forget (session *sess);
+void inbound_netsplit_casemap (server *serv);
+void inbound_netsplit_free (server *serv);
 void inbound_uaway (server *serv, const message_tags_data *tags_data);
 void inbound_account (server *serv, char *nick, char *account,
 							 const message_tags_data *tags_data);
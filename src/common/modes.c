@@ -852,6 +852,8 @@ inbound_005 (server * serv, char *word[], const message_tags_data *tags_data)
 	char *pre;
 	char *tokname, *tokvalue;
 	gboolean tokadding;
+	GSList *list;
+	session *sess;
 
 	w = 4;							  /* start at the 4th word */
 	while (w < PDIWORDS && *word[w])
@@ -902,11 +904,23 @@ inbound_005 (server * serv, char *word[], const message_tags_data *tags_data)
 				safe_strcpy (serv->server_session->channel, tokvalue, CHANLEN);
 				fe_set_channel (serv->server_session);
 			}
+			/* the network is part of every log path, recheck them all */
+			for (list = sess_list; list; list = list->next)
+			{
+				sess = list->data;
+				if (sess->server == serv)
+					sess->logcheck = 0;
+			}
 
 		} else if (g_strcmp0 (tokname, "CASEMAPPING") == 0)
 		{
 			if (g_strcmp0 (tokvalue, "ascii") == 0)
+			{
 				serv->p_cmp = (void *)g_ascii_strcasecmp;
+				userlist_reindex (serv);
+				inbound_netsplit_casemap (serv);
+				g_clear_pointer (&serv->channels, g_hash_table_destroy);
+			}
 		} else if (g_strcmp0 (tokname, "CHARSET") == 0)
 		{
 			if (g_ascii_strcasecmp (tokvalue, "UTF-8") == 0)
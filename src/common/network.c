@@ -24,8 +24,12 @@
 #include <string.h>
 #include <stdio.h>
 #include <glib.h>
+#include <gio/gio.h>
 
 #ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/select.h>
 #include <unistd.h>
 #endif
 
@@ -128,40 +132,237 @@ net_resolve (netstore * ns, char *hostname, int port, char **real_host)
 	return g_strdup (ipstring);
 }
 
-/* the only thing making this interface unclean, this shitty sok4, sok6 business */
+/* Connecting races the two address families, as in RFC 8305: addresses of
+   the first result's family are tried in turn on one socket, and if none
+   has connected after NET_CONNECT_DELAY ms, the other family's are tried
+   on the other socket alongside. The first to connect wins. There's one
+   socket per family because the parent process only knows sok4 and sok6. */
+
+#define NET_CONNECT_DELAY 250
+
+typedef struct
+{
+	int sok;
+	GPtrArray *addrs;		/* struct sockaddr_storage of this family */
+	guint next;				/* next address to try */
+	gboolean pending;		/* connect() in progress */
+} net_lane;
+
+/* start connecting on the next address, TRUE if it connected at once */
+
+static gboolean
+net_lane_connect (net_lane *lane, int *error)
+{
+	struct sockaddr_storage *addr;
+	socklen_t len;
+
+	lane->pending = FALSE;
+	while (lane->sok != -1 && lane->next < lane->addrs->len)
+	{
+		addr = g_ptr_array_index (lane->addrs, lane->next++);
+		len = addr->ss_family == AF_INET6 ? sizeof (struct sockaddr_in6)
+													 : sizeof (struct sockaddr_in);
+		if (connect (lane->sok, (struct sockaddr *)addr, len) == 0)
+			return TRUE;
+#ifdef WIN32
+		if (sock_error () == WSAEWOULDBLOCK)
+#else
+		if (sock_error () == EINPROGRESS)
+#endif
+		{
+			lane->pending = TRUE;
+			return FALSE;
+		}
+		*error = sock_error ();
+	}
+	return FALSE;
+}
+
+/* Connect to the first of addrs (struct sockaddr_storage) that answers.
+   This runs in the forked child, so it must stay clear of GObject. */
 
 int
-net_connect (netstore * ns, int sok4, int sok6, int *sok_return)
+net_connect_race (GPtrArray *addrs, int sok4, int sok6, int *sok_return)
 {
-	struct addrinfo *res, *res0;
-	int error = -1;
+	net_lane lanes[2];	/* the first address's family, then the other */
+	struct sockaddr_storage *addr;
+	struct timeval tv, *tvp;
+	fd_set wfds, efds;
+	gint64 race_at;
+	int error = -1, winner = -1, first_family, maxfd, soerr, i;
+	socklen_t len;
+	guint j;
+
+	if (!addrs->len)
+		return -1;
+
+	addr = g_ptr_array_index (addrs, 0);
+	first_family = addr->ss_family;
+	lanes[0].sok = first_family == AF_INET6 ? sok6 : sok4;
+	lanes[1].sok = first_family == AF_INET6 ? sok4 : sok6;
+	for (i = 0; i < 2; i++)
+	{
+		lanes[i].addrs = g_ptr_array_new ();
+		lanes[i].next = 0;
+		lanes[i].pending = FALSE;
+		if (lanes[i].sok != -1)
+			set_nonblocking (lanes[i].sok);
+	}
+	for (j = 0; j < addrs->len; j++)
+	{
+		addr = g_ptr_array_index (addrs, j);
+		i = addr->ss_family == first_family ? 0 : 1;
+		g_ptr_array_add (lanes[i].addrs, addr);
+	}
 
-	res0 = ns->ip6_hostent;
+	/* when to start on the other family, 0 once it has been */
+	race_at = g_get_monotonic_time () + NET_CONNECT_DELAY * 1000;
+	if (net_lane_connect (&lanes[0], &error))
+		winner = 0;
+	else if (!lanes[0].pending)
+		race_at = 1;	/* nothing to wait for */
 
-	for (res = res0; res; res = res->ai_next)
+	while (winner == -1)
 	{
-/*		sok = socket (res->ai_family, res->ai_socktype, res->ai_protocol);
-		if (sok < 0)
-			continue;*/
-		switch (res->ai_family)
+		if (race_at && g_get_monotonic_time () >= race_at)
 		{
-		case AF_INET:
-			error = connect (sok4, res->ai_addr, res->ai_addrlen);
-			*sok_return = sok4;
-			break;
-		case AF_INET6:
-			error = connect (sok6, res->ai_addr, res->ai_addrlen);
-			*sok_return = sok6;
-			break;
-		default:
-			error = 1;
+			race_at = 0;
+			if (net_lane_connect (&lanes[1], &error))
+			{
+				winner = 1;
+				break;
+			}
+		}
+
+		if (!lanes[0].pending && !lanes[1].pending && !race_at)
+			break;	/* every address failed */
+
+		FD_ZERO (&wfds);
+		FD_ZERO (&efds);
+		maxfd = -1;
+		for (i = 0; i < 2; i++)
+		{
+			if (lanes[i].pending)
+			{
+				FD_SET (lanes[i].sok, &wfds);
+				FD_SET (lanes[i].sok, &efds);	/* winsock reports failures here */
+				maxfd = MAX (maxfd, lanes[i].sok);
+			}
+		}
+
+		tvp = NULL;
+		if (race_at)
+		{
+			gint64 wait = MAX (race_at - g_get_monotonic_time (), 0);
+			tv.tv_sec = wait / G_USEC_PER_SEC;
+			tv.tv_usec = wait % G_USEC_PER_SEC;
+			tvp = &tv;
 		}
 
-		if (error == 0)
+		if (select (maxfd + 1, NULL, &wfds, &efds, tvp) < 0)
+		{
+#ifndef WIN32
+			if (errno == EINTR)
+				continue;
+#endif
+			error = sock_error ();
 			break;
+		}
+
+		for (i = 0; i < 2 && winner == -1; i++)
+		{
+			if (!lanes[i].pending ||
+				 (!FD_ISSET (lanes[i].sok, &wfds) && !FD_ISSET (lanes[i].sok, &efds)))
+				continue;
+
+			soerr = 0;
+			len = sizeof (soerr);
+			getsockopt (lanes[i].sok, SOL_SOCKET, SO_ERROR, (char *)&soerr, &len);
+			if (soerr == 0)
+			{
+				winner = i;
+				break;
+			}
+
+			/* this address failed, go on with the family's next one, and
+				don't keep the other family waiting any longer */
+			error = soerr;
+			if (net_lane_connect (&lanes[i], &error))
+				winner = i;
+			else if (race_at)
+				race_at = 1;	/* start the other family now */
+		}
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		if (lanes[i].sok != -1)
+			set_blocking (lanes[i].sok);
+		g_ptr_array_free (lanes[i].addrs, TRUE);
+	}
+
+	if (winner == -1)
+	{
+#ifdef WIN32
+		WSASetLastError (error);
+#else
+		errno = error;
+#endif
+		return -1;
+	}
+
+	*sok_return = lanes[winner].sok;
+	return 0;
+}
+
+/* the only thing making this interface unclean, this shitty sok4, sok6 business */
+
+int
+net_connect (netstore * ns, int sok4, int sok6, int *sok_return)
+{
+	GPtrArray *addrs;
+	struct addrinfo *res;
+	struct sockaddr_storage *addr;
+	int ret;
+
+	addrs = g_ptr_array_new_with_free_func (g_free);
+	for (res = ns->ip6_hostent; res; res = res->ai_next)
+	{
+		if (res->ai_family != AF_INET && res->ai_family != AF_INET6)
+			continue;
+		addr = g_new0 (struct sockaddr_storage, 1);
+		memcpy (addr, res->ai_addr, MIN (res->ai_addrlen, sizeof (*addr)));
+		g_ptr_array_add (addrs, addr);
+	}
+
+	ret = net_connect_race (addrs, sok4, sok6, sok_return);
+	g_ptr_array_free (addrs, TRUE);
+	return ret;
+}
+
+/* turn a list of GInetAddress into what net_connect_race() takes; do this
+   before forking, GLib's resolver threads won't exist in the child */
+
+GPtrArray *
+net_addresses_to_native (GList *addresses, int port)
+{
+	GPtrArray *addrs;
+	GSocketAddress *sa;
+	struct sockaddr_storage *addr;
+
+	addrs = g_ptr_array_new_with_free_func (g_free);
+	for (; addresses; addresses = addresses->next)
+	{
+		sa = g_inet_socket_address_new (addresses->data, port);
+		addr = g_new0 (struct sockaddr_storage, 1);
+		if (g_socket_address_to_native (sa, addr, sizeof (*addr), NULL))
+			g_ptr_array_add (addrs, addr);
+		else
+			g_free (addr);
+		g_object_unref (sa);
 	}
 
-	return error;
+	return addrs;
 }
 
 void
@@ -34,6 +34,8 @@ typedef struct netstore_
 netstore *net_store_new (void);
 void net_store_destroy (netstore *ns);
 int net_connect (netstore *ns, int sok4, int sok6, int *sok_return);
+int net_connect_race (GPtrArray *addrs, int sok4, int sok6, int *sok_return);
+GPtrArray *net_addresses_to_native (GList *addresses, int port);
 char *net_resolve (netstore *ns, char *hostname, int port, char **real_host);
 void net_bind (netstore *tobindto, int sok4, int sok6);
 char *net_ip (guint32 addr);
@@ -36,6 +36,7 @@
 #include "fe.h"
 #include "server.h"
 #include "text.h"
+#include "userlist.h"
 #include "util.h"
 #include "hexchatc.h"
 
@@ -43,6 +44,22 @@
 GSList *notify_list = 0;
 int notify_tag = 0;
 
+/* name -> GSList of the notify entries with that name, newest first like
+   notify_list. A nick can be on the list once for each network. */
+static GHashTable *notify_index = NULL;
+
+/* "ISON " + nicks + CRLF must fit in 512 bytes */
+#define NOTIFY_ISON_LEN 450
+/* ms between ISON lines when there's no notify timer to spread them over */
+#define NOTIFY_ISON_GAP 2000
+
+struct notify_ison
+{
+	GQueue unsent;	/* this round's lines still to be sent */
+	GQueue sent;	/* lines waiting for their 303 reply, oldest first */
+	int tag;
+};
+
 
 static char *
 despacify_dup (char *str)
@@ -177,28 +194,60 @@ notify_load (void)
 	}
 }
 
+/* all entries that might be nick; the table compares like rfc_casecmp, so
+   the caller still has to check with serv->p_cmp */
+
+static GSList *
+notify_index_lookup (const char *nick)
+{
+	if (!notify_index)
+		return NULL;
+
+	return g_hash_table_lookup (notify_index, nick);
+}
+
+static void
+notify_index_add (struct notify *notify)
+{
+	GSList *same;
+
+	if (!notify_index)
+		notify_index = casemap_hash_table_new (rfc_casecmp, g_free, NULL);
+
+	same = g_hash_table_lookup (notify_index, notify->name);
+	g_hash_table_insert (notify_index, g_strdup (notify->name),
+								g_slist_prepend (same, notify));
+}
+
+static void
+notify_index_remove (struct notify *notify)
+{
+	GSList *same;
+
+	same = g_slist_remove (notify_index_lookup (notify->name), notify);
+	if (same)
+		g_hash_table_insert (notify_index, g_strdup (notify->name), same);
+	else
+		g_hash_table_remove (notify_index, notify->name);
+}
+
 static struct notify_per_server *
 notify_find (server *serv, char *nick)
 {
-	GSList *list = notify_list;
+	GSList *list;
 	struct notify_per_server *servnot;
 	struct notify *notify;
 
-	while (list)
+	for (list = notify_index_lookup (nick); list; list = list->next)
 	{
 		notify = (struct notify *) list->data;
 
-		servnot = notify_find_server_entry (notify, serv);
-		if (!servnot)
-		{
-			list = list->next;
+		if (serv->p_cmp (notify->name, nick))
 			continue;
-		}
 
-		if (!serv->p_cmp (notify->name, nick))
+		servnot = notify_find_server_entry (notify, serv);
+		if (servnot)
 			return servnot;
-
-		list = list->next;
 	}
 
 	return NULL;
@@ -284,6 +333,32 @@ notify_set_online (server * serv, char *nick,
 	notify_announce_online (serv, servnot, nick, tags_data);
 }
 
+/* a whole NAMES reply was added to sess, check each notify nick against
+   its userlist once rather than each new user against the notify list */
+
+void
+notify_set_online_users (server * serv, session *sess,
+								 const message_tags_data *tags_data)
+{
+	GSList *list;
+	struct notify_per_server *servnot;
+	struct notify *notify;
+	struct User *user;
+
+	for (list = notify_list; list; list = list->next)
+	{
+		notify = (struct notify *) list->data;
+
+		servnot = notify_find_server_entry (notify, serv);
+		if (!servnot)
+			continue;
+
+		user = userlist_find (sess, notify->name);
+		if (user)
+			notify_announce_online (serv, servnot, user->nick, tags_data);
+	}
+}
+
 /* monitor can send lists for numeric 730/731 */
 
 void
@@ -444,86 +519,152 @@ notify_send_watches (server * serv)
 	g_slist_free (send_list);
 }
 
-/* called when receiving a ISON 303 - should this func go? */
+/* called when receiving a ISON 303. It answers the oldest line we sent, so
+   only the nicks in that line can be marked offline. */
 
 void
-notify_markonline (server *serv, char *word[], const message_tags_data *tags_data)
+notify_markonline (server *serv, char *nicks, const message_tags_data *tags_data)
 {
-	struct notify *notify;
 	struct notify_per_server *servnot;
-	GSList *list = notify_list;
-	int i, seen;
+	char **online, **asked;
+	char *line = NULL;
+	int i, j;
 
-	while (list)
+	if (serv->ison)
+		line = g_queue_pop_head (&serv->ison->sent);
+
+	online = g_strsplit (nicks, " ", 0);
+	for (i = 0; online[i]; i++)
 	{
-		notify = (struct notify *) list->data;
-		servnot = notify_find_server_entry (notify, serv);
-		if (!servnot)
-		{
-			list = list->next;
-			continue;
-		}
-		i = 4;
-		seen = FALSE;
-		while (*word[i])
+		servnot = notify_find (serv, online[i]);
+		if (servnot)
+			notify_announce_online (serv, servnot, servnot->notify->name, tags_data);
+	}
+
+	if (line)
+	{
+		asked = g_strsplit (line, " ", 0);
+		for (i = 0; asked[i]; i++)
 		{
-			if (!serv->p_cmp (notify->name, word[i]))
+			for (j = 0; online[j]; j++)
 			{
-				seen = TRUE;
-				notify_announce_online (serv, servnot, notify->name, tags_data);
-				break;
-			}
-			i++;
-			/* FIXME: word[] is only a 32 element array, limits notify list to
-			   about 27 people */
-			if (i > PDIWORDS - 5)
-			{
-				/*fprintf (stderr, _("*** HEXCHAT WARNING: notify list too large.\n"));*/
-				break;
+				if (!serv->p_cmp (asked[i], online[j]))
+					break;
 			}
+			if (online[j])
+				continue;
+
+			servnot = notify_find (serv, asked[i]);
+			if (servnot && servnot->ison)
+				notify_announce_offline (serv, servnot, servnot->notify->name, FALSE, tags_data);
 		}
-		if (!seen && servnot->ison)
-		{
-			notify_announce_offline (serv, servnot, notify->name, FALSE, tags_data);
-		}
-		list = list->next;
+		g_strfreev (asked);
+		g_free (line);
 	}
+
+	g_strfreev (online);
 	fe_notify_update (0);
 }
 
-/* yuck! Old routine for ISON notify */
+static int
+notify_ison_send (server *serv)
+{
+	struct notify_ison *ison = serv->ison;
+	char *line, *cmd;
+
+	line = g_queue_pop_head (&ison->unsent);
+	cmd = g_strconcat ("ISON ", line, NULL);
+	serv->p_raw (serv, cmd);
+	g_free (cmd);
+	g_queue_push_tail (&ison->sent, line);
+
+	if (ison->unsent.length)
+		return 1;
+
+	ison->tag = 0;
+	return 0;
+}
+
+/* Split this server's part of the notify list into ISON lines. The first
+   goes out now, the rest are spread over the time until the next round so
+   they don't pile up in the send queue. */
 
 static void
 notify_checklist_for_server (server *serv)
 {
-	char outbuf[512];
+	struct notify_ison *ison = serv->ison;
 	struct notify *notify;
-	GSList *list = notify_list;
-	int i = 0;
+	GString *line = NULL;
+	GSList *list;
+	int gap;
+
+	if (!ison)
+	{
+		ison = g_new0 (struct notify_ison, 1);
+		serv->ison = ison;
+	}
+	else if (ison->unsent.length)
+	{
+		return;	/* still sending the last round */
+	}
+
+	/* anything not answered by now never will be, don't let it pair up
+	   with the wrong reply */
+	g_list_free_full (ison->sent.head, g_free);
+	g_queue_init (&ison->sent);
 
-	strcpy (outbuf, "ISON ");
+	list = notify_list;
 	while (list)
 	{
 		notify = list->data;
 		if (notify_do_network (notify, serv))
 		{
-			i++;
-			strcat (outbuf, notify->name);
-			strcat (outbuf, " ");
-			if (strlen (outbuf) > 460)
+			if (line && line->len + strlen (notify->name) + 1 > NOTIFY_ISON_LEN)
+			{
+				g_queue_push_tail (&ison->unsent, g_string_free (line, FALSE));
+				line = NULL;
+			}
+			if (!line)
+			{
+				line = g_string_new (notify->name);
+			}
+			else
 			{
-				/* LAME: we can't send more than 512 bytes to the server, but     *
-				 * if we split it in two packets, our offline detection wouldn't  *
-				 work                                                           */
-				/*fprintf (stderr, _("*** HEXCHAT WARNING: notify list too large.\n"));*/
-				break;
+				g_string_append_c (line, ' ');
+				g_string_append (line, notify->name);
 			}
 		}
 		list = list->next;
 	}
 
-	if (i)
-		serv->p_raw (serv, outbuf);
+	if (!line)
+		return;
+	g_queue_push_tail (&ison->unsent, g_string_free (line, FALSE));
+
+	gap = NOTIFY_ISON_GAP;
+	if (prefs.hex_notify_timeout)
+		gap = prefs.hex_notify_timeout * 1000 / ison->unsent.length;
+
+	if (notify_ison_send (serv))
+		ison->tag = fe_timeout_add (gap, notify_ison_send, serv);
+}
+
+/* forget the ISON state, the server disconnected or is going away */
+
+void
+notify_server_reset (server *serv)
+{
+	struct notify_ison *ison = serv->ison;
+
+	if (!ison)
+		return;
+
+	if (ison->tag)
+		fe_timeout_remove (ison->tag);
+	g_list_free_full (ison->unsent.head, g_free);
+	g_list_free_full (ison->sent.head, g_free);
+	g_free (ison);
+	serv->ison = NULL;
 }
 
 int
@@ -599,6 +740,7 @@ notify_deluser (char *name)
 				g_free (servnot);
 			}
 			notify_list = g_slist_remove (notify_list, notify);
+			notify_index_remove (notify);
 			notify_watch_all (notify, FALSE);
 			g_free (notify->networks);
 			g_free (notify->name);
@@ -622,6 +764,7 @@ notify_adduser (char *name, char *networks)
 		notify->networks = despacify_dup (networks);
 	notify->server_list = 0;
 	notify_list = g_slist_prepend (notify_list, notify);
+	notify_index_add (notify);
 	notify_checklist ();
 	fe_notify_update (notify->name);
 	fe_notify_update (0);
@@ -632,7 +775,7 @@ gboolean
 notify_is_in_list (server *serv, char *name)
 {
 	struct notify *notify;
-	GSList *list = notify_list;
+	GSList *list = notify_index_lookup (name);
 
 	while (list)
 	{
@@ -650,7 +793,7 @@ notify_isnotify (struct session *sess, char *name)
 {
 	struct notify *notify;
 	struct notify_per_server *servnot;
-	GSList *list = notify_list;
+	GSList *list = notify_index_lookup (name);
 
 	while (list)
 	{
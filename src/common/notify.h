@@ -47,6 +47,8 @@ void notify_set_online (server * serv, char *nick,
 								const message_tags_data *tags_data);
 void notify_set_offline (server * serv, char *nick, int quiet,
 								 const message_tags_data *tags_data);
+void notify_set_online_users (server * serv, session *sess,
+										const message_tags_data *tags_data);
 /* the MONITOR stuff */
 void notify_set_online_list (server * serv, char *users,
 								const message_tags_data *tags_data);
@@ -65,9 +67,10 @@ gboolean notify_is_in_list (server *serv, char *name);
 int notify_isnotify (session *sess, char *name);
 struct notify_per_server *notify_find_server_entry (struct notify *notify, struct server *serv);
 
-/* the old ISON stuff - remove me? */
-void notify_markonline (server *serv, char *word[], 
+/* the ISON stuff, for servers without either */
+void notify_markonline (server *serv, char *nicks,
 								const message_tags_data *tags_data);
 int notify_checklist (void);
+void notify_server_reset (server *serv);
 
 #endif
@@ -880,6 +880,7 @@ static int cmd_mdehop(struct session *sess, char *tbuf, char *word[],
 
   data.nicks = nicks;
   data.i = 0;
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)mdehop_cb, &data);
   send_channel_modes(sess, tbuf, nicks, 0, data.i, '-', 'h', 0);
   g_free(nicks);
@@ -902,6 +903,7 @@ static int cmd_mdeop(struct session *sess, char *tbuf, char *word[],
 
   data.nicks = nicks;
   data.i = 0;
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)mdeop_cb, &data);
   send_channel_modes(sess, tbuf, nicks, 0, data.i, '-', 'o', 0);
   g_free(nicks);
@@ -1194,6 +1196,7 @@ static int cmd_mhop(struct session *sess, char *tbuf, char *word[],
 
   data.nicks = nicks;
   data.i = 0;
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)mhop_cb, &data);
   send_channel_modes(sess, tbuf, nicks, 0, data.i, '+', 'h', 0);
 
@@ -1222,6 +1225,7 @@ static int cmd_mkick(struct session *sess, char *tbuf, char *word[],
 
   data.sess = sess;
   data.reason = word_eol[2];
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)mkickops_cb, &data);
   tree_foreach(sess->usertree, (tree_traverse_func *)mkick_cb, &data);
 
@@ -2272,6 +2276,9 @@ static int cmd_lastlog(struct session *sess, char *tbuf, char *word[],
     case 'h':
       flags |= highlight;
       break;
+    case 'a':
+      flags |= all_tabs;
+      break;
     case '-':
       doublehyphen = TRUE;
       break;
@@ -2507,6 +2514,7 @@ static int cmd_mop(struct session *sess, char *tbuf, char *word[],
 
   data.nicks = nicks;
   data.i = 0;
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)mop_cb, &data);
   send_channel_modes(sess, tbuf, nicks, 0, data.i, '+', 'o', 0);
 
@@ -3425,6 +3433,7 @@ static int cmd_uselect(struct session *sess, char *tbuf, char *word[],
 
 static int cmd_userlist(struct session *sess, char *tbuf, char *word[],
                         char *word_eol[]) {
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)userlist_cb, sess);
   return TRUE;
 }
@@ -3460,6 +3469,7 @@ static int cmd_wallchop(struct session *sess, char *tbuf, char *word[],
   data.tbuf = tbuf;
   data.i = 0;
   data.sess = sess;
+  userlist_flush_pending(sess);
   tree_foreach(sess->usertree, (tree_traverse_func *)wallchop_cb, &data);
 
   if (data.i) {
@@ -3632,8 +3642,9 @@ const struct commands xc_cmds[] = {
     {"KILLALL", cmd_killall, 0, 0, 1, "KILLALL, immediately exit"},
     {"LAGCHECK", cmd_lagcheck, 0, 0, 1, N_("LAGCHECK, forces a new lag check")},
     {"LASTLOG", cmd_lastlog, 0, 0, 1,
-     N_("LASTLOG [-h] [-m] [-r] [--] <string>, searches for a string in the "
-        "buffer\n"
+     N_("LASTLOG [-a] [-h] [-m] [-r] [--] <string>, searches for a string in "
+        "the buffer\n"
+        "    Use -a to search every tab of the current network\n"
         "    Use -h to highlight the found string(s)\n"
         "    Use -m to match case\n"
         "    Use -r when string is a Regular Expression\n"
@@ -4118,6 +4129,7 @@ static void perform_nick_completion(struct session *sess, char *cmd,
         data.best = NULL;
         data.tbuf = tbuf;
         data.space = space - 1;
+        userlist_flush_pending(sess);
         tree_foreach(sess->usertree, (tree_traverse_func *)nick_comp_cb, &data);
 
         if (data.len == -1)
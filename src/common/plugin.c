@@ -68,6 +68,7 @@ struct _hexchat_hook
 	int tag;				/* for timers & FDs only */
 	int type;			/* HOOK_* */
 	int pri;	/* fd */	/* priority / fd for HOOK_FD only */
+	guint serial;		/* newer hooks run first among equal priorities */
 };
 
 struct _hexchat_list
@@ -98,10 +99,9 @@ enum
 	LIST_USERS
 };
 
-/* We use binary flags here because it makes it possible for plugin_hook_find()
- * to match several types of hooks.  This is used so that plugin_hook_run()
- * match both HOOK_SERVER and HOOK_SERVER_ATTRS hooks when plugin_emit_server()
- * is called.
+/* We use binary flags here because it makes it possible for plugin_hook_run()
+ * to match several types of hooks.  This is used so that it matches both
+ * HOOK_SERVER and HOOK_SERVER_ATTRS hooks when plugin_emit_server() is called.
  */
 enum
 {
@@ -146,6 +146,17 @@ enum
 GSList *plugin_list = NULL;	/* export for plugingui.c */
 static GSList *hook_list = NULL;
 
+/* Commands, server and print hooks are also kept in a table per kind, from
+   name to a GPtrArray of hooks in the order they run. "RAW LINE" server
+   hooks run for every name and have an array of their own. */
+static GHashTable *hook_commands = NULL;
+static GHashTable *hook_servers = NULL;
+static GHashTable *hook_prints = NULL;
+static GPtrArray *hook_raw_line = NULL;
+static guint hook_serial = 0;
+static int hook_run_depth = 0;		/* plugin_hook_run()s in progress */
+static gboolean hook_deleted = FALSE;	/* HOOK_DELETED hooks waiting in hook_list */
+
 extern const struct prefs vars[];	/* cfgfiles.c */
 
 
@@ -187,6 +198,8 @@ plugin_free (hexchat_plugin *pl, int do_deinit, int allow_refuse)
 #endif
 
 xit:
+	pluginpref_flush ();
+
 	if (pl->free_strings)
 	{
 		g_free (pl->name);
@@ -544,27 +557,110 @@ plugin_reload (session *sess, char *name, int by_filename)
 
 #endif
 
-static GSList *
-plugin_hook_find (GSList *list, int type, char *name)
+static guint
+plugin_hook_name_hash (gconstpointer key)
+{
+	const char *p = key;
+	guint h = 5381;
+
+	for (; *p; p++)
+		h = (h << 5) + h + g_ascii_tolower (*p);
+
+	return h;
+}
+
+static gboolean
+plugin_hook_name_equal (gconstpointer a, gconstpointer b)
+{
+	return g_ascii_strcasecmp (a, b) == 0;
+}
+
+static GHashTable **
+plugin_hook_table (int type)
+{
+	if (type & HOOK_COMMAND)
+		return &hook_commands;
+	if (type & (HOOK_SERVER | HOOK_SERVER_ATTRS))
+		return &hook_servers;
+	if (type & (HOOK_PRINT | HOOK_PRINT_ATTRS))
+		return &hook_prints;
+
+	return NULL;	/* timers and fds aren't looked up by name */
+}
+
+/* the array this hook is dispatched from, NULL for timers and fds */
+
+static GPtrArray *
+plugin_hook_bucket (hexchat_hook *hook, gboolean create)
 {
+	GHashTable **table;
+	GPtrArray *bucket;
+
+	table = plugin_hook_table (hook->type);
+	if (!table || !hook->name)
+		return NULL;
+
+	if ((hook->type & (HOOK_SERVER | HOOK_SERVER_ATTRS))
+		 && g_ascii_strcasecmp (hook->name, "RAW LINE") == 0)
+	{
+		if (!hook_raw_line && create)
+			hook_raw_line = g_ptr_array_new ();
+		return hook_raw_line;
+	}
+
+	if (!*table)
+	{
+		if (!create)
+			return NULL;
+		*table = g_hash_table_new_full (plugin_hook_name_hash, plugin_hook_name_equal,
+												  g_free, (GDestroyNotify) g_ptr_array_unref);
+	}
+
+	bucket = g_hash_table_lookup (*table, hook->name);
+	if (!bucket && create)
+	{
+		bucket = g_ptr_array_new ();
+		g_hash_table_insert (*table, g_strdup (hook->name), bucket);
+	}
+
+	return bucket;
+}
+
+/* does hook a run before hook b? */
+
+static gboolean
+plugin_hook_before (hexchat_hook *a, hexchat_hook *b)
+{
+	if (a->pri != b->pri)
+		return a->pri > b->pri;
+	return a->serial > b->serial;
+}
+
+/* really remove deleted hooks, once nothing is iterating over them */
+
+static void
+plugin_hook_sweep (void)
+{
+	GSList *list, *next;
 	hexchat_hook *hook;
 
+	if (!hook_deleted || hook_run_depth)
+		return;
+
+	list = hook_list;
 	while (list)
 	{
 		hook = list->data;
-		if (hook && (hook->type & type))
+		next = list->next;
+		if (!hook || hook->type == HOOK_DELETED)
 		{
-			if (g_ascii_strcasecmp (hook->name, name) == 0)
-				return list;
-
-			if ((type & HOOK_SERVER)
-				&& g_ascii_strcasecmp (hook->name, "RAW LINE") == 0)
-					return list;
+			hook_list = g_slist_delete_link (hook_list, list);
+			g_free (hook);
 		}
-		list = list->next;
+		list = next;
 	}
 
-	return NULL;
+	hook_deleted = FALSE;
 }
 
 /* check for plugin hooks and run them */
@@ -573,19 +669,54 @@ static int
 plugin_hook_run (session *sess, char *name, char *word[], char *word_eol[],
 				 hexchat_event_attrs *attrs, int type)
 {
-	GSList *list, *next;
+	GHashTable *table = *plugin_hook_table (type);
+	GPtrArray *bucket = NULL, *raw = NULL;
+	hexchat_hook *stack_hooks[16], **hooks;
 	hexchat_hook *hook;
+	guint count, i, j, k;
 	int ret, eat = 0;
 
-	list = hook_list;
-	while (1)
+	if (table)
+		bucket = g_hash_table_lookup (table, name);
+	if (type & HOOK_SERVER)
+		raw = hook_raw_line;
+
+	count = (bucket ? bucket->len : 0) + (raw ? raw->len : 0);
+	if (!count)
 	{
-		list = plugin_hook_find (list, type, name);
-		if (!list)
-			goto xit;
+		plugin_hook_sweep ();
+		return 0;
+	}
+
+	/* run from a copy, callbacks can (un)hook. Merge the name's hooks with
+	   the RAW LINE ones in priority order. */
+	if (count <= G_N_ELEMENTS (stack_hooks))
+		hooks = stack_hooks;
+	else
+		hooks = g_new (hexchat_hook *, count);
+
+	for (i = j = k = 0; k < count; k++)
+	{
+		if (!raw || j == raw->len)
+			hooks[k] = g_ptr_array_index (bucket, i++);
+		else if (!bucket || i == bucket->len)
+			hooks[k] = g_ptr_array_index (raw, j++);
+		else if (plugin_hook_before (g_ptr_array_index (bucket, i), g_ptr_array_index (raw, j)))
+			hooks[k] = g_ptr_array_index (bucket, i++);
+		else
+			hooks[k] = g_ptr_array_index (raw, j++);
+	}
+
+	hook_run_depth++;
+
+	for (k = 0; k < count; k++)
+	{
+		hook = hooks[k];
+
+		/* unhooked by an earlier callback? */
+		if (!(hook->type & type))
+			continue;
 
-		hook = list->data;
-		next = list->next;
 		hook->pl->context = sess;
 
 		/* run the plugin's callback function */
@@ -611,30 +742,20 @@ plugin_hook_run (session *sess, char *name, char *word[], char *word_eol[],
 		if ((ret & HEXCHAT_EAT_HEXCHAT) && (ret & HEXCHAT_EAT_PLUGIN))
 		{
 			eat = 1;
-			goto xit;
+			break;
 		}
 		if (ret & HEXCHAT_EAT_PLUGIN)
-			goto xit;	/* stop running plugins */
+			break;	/* stop running plugins */
 		if (ret & HEXCHAT_EAT_HEXCHAT)
 			eat = 1;	/* eventually we'll return 1, but continue running plugins */
-
-		list = next;
 	}
 
-xit:
-	/* really remove deleted hooks now */
-	list = hook_list;
-	while (list)
-	{
-		hook = list->data;
-		next = list->next;
-		if (!hook || hook->type == HOOK_DELETED)
-		{
-			hook_list = g_slist_remove (hook_list, hook);
-			g_free (hook);
-		}
-		list = next;
-	}
+	hook_run_depth--;
+
+	if (hooks != stack_hooks)
+		g_free (hooks);
+
+	plugin_hook_sweep ();
 
 	return eat;
 }
@@ -686,6 +807,20 @@ plugin_emit_print (session *sess, char *word[], time_t server_time)
 							HOOK_PRINT | HOOK_PRINT_ATTRS);
 }
 
+/* does any plugin hook this print event? */
+
+int
+plugin_print_hooked (const char *name)
+{
+	GPtrArray *bucket;
+
+	if (!hook_prints)
+		return FALSE;
+
+	bucket = g_hash_table_lookup (hook_prints, name);
+	return bucket && bucket->len;
+}
+
 int
 plugin_emit_dummy_print (session *sess, char *name)
 {
@@ -762,8 +897,10 @@ static void
 plugin_insert_hook (hexchat_hook *new_hook)
 {
 	GSList *list;
+	GPtrArray *bucket;
 	hexchat_hook *hook;
 	int new_hook_type;
+	guint i;
  
 	switch (new_hook->type)
 	{
@@ -779,6 +916,23 @@ plugin_insert_hook (hexchat_hook *new_hook)
 			new_hook_type = new_hook->type;
 	}
 
+	new_hook->serial = ++hook_serial;
+
+	bucket = plugin_hook_bucket (new_hook, TRUE);
+	if (bucket)
+	{
+		for (i = 0; i < bucket->len; i++)
+		{
+			if (plugin_hook_before (new_hook, g_ptr_array_index (bucket, i)))
+				break;
+		}
+		/* g_ptr_array_insert() needs glib 2.40 */
+		g_ptr_array_add (bucket, NULL);
+		memmove (bucket->pdata + i + 1, bucket->pdata + i,
+					(bucket->len - 1 - i) * sizeof (gpointer));
+		bucket->pdata[i] = new_hook;
+	}
+
 	list = hook_list;
 	while (list)
 	{
@@ -886,13 +1040,14 @@ plugin_command_foreach (session *sess, void *userdata,
 int
 plugin_show_help (session *sess, char *cmd)
 {
-	GSList *list;
+	GPtrArray *bucket = NULL;
 	hexchat_hook *hook;
 
-	list = plugin_hook_find (hook_list, HOOK_COMMAND, cmd);
-	if (list)
+	if (hook_commands)
+		bucket = g_hash_table_lookup (hook_commands, cmd);
+	if (bucket && bucket->len)
 	{
-		hook = list->data;
+		hook = g_ptr_array_index (bucket, 0);
 		if (hook->help_text)
 		{
 			PrintText (sess, hook->help_text);
@@ -971,6 +1126,8 @@ plugin_find_context (const char *servname, const char *channel, server *current_
 void *
 hexchat_unhook (hexchat_plugin *ph, hexchat_hook *hook)
 {
+	GPtrArray *bucket;
+
 	/* perl.c trips this */
 	if (!g_slist_find (hook_list, hook) || hook->type == HOOK_DELETED)
 		return NULL;
@@ -981,7 +1138,16 @@ hexchat_unhook (hexchat_plugin *ph, hexchat_hook *hook)
 	if (hook->type == HOOK_FD && hook->tag != 0)
 		fe_input_remove (hook->tag);
 
+	bucket = plugin_hook_bucket (hook, FALSE);
+	if (bucket)
+	{
+		g_ptr_array_remove (bucket, hook);
+		if (!bucket->len && bucket != hook_raw_line)
+			g_hash_table_remove (*plugin_hook_table (hook->type), hook->name);
+	}
+
 	hook->type = HOOK_DELETED;	/* expunge later */
+	hook_deleted = TRUE;
 
 	g_free (hook->name);	/* NULL for timers & fds */
 	g_free (hook->help_text);	/* NULL for non-commands */
@@ -1375,7 +1541,7 @@ hexchat_list_fields (hexchat_plugin *ph, const char *name)
 	static const char * const dcc_fields[] =
 	{
 		"iaddress32","icps",		"sdestfile","sfile",		"snick",	"iport",
-		"ipos", "iposhigh", "iresume", "iresumehigh", "isize", "isizehigh", "istatus", "itype", NULL
+		"ipos", "iposhigh", "iresume", "iresumehigh", "ssha256", "isize", "isizehigh", "istatus", "itype", NULL
 	};
 	static const char * const channels_fields[] =
 	{
@@ -1502,6 +1668,8 @@ hexchat_list_str (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
 			return ((struct DCC *)data)->file;
 		case 0x339763: /* nick */
 			return ((struct DCC *)data)->nick;
+		case 0xca23b627:	/* sha256 */
+			return ((struct DCC *)data)->sha256;
 		}
 		break;
 
@@ -1787,149 +1955,232 @@ hexchat_free (hexchat_plugin *ph, void *ptr)
 	g_free (ptr);
 }
 
-static int
-hexchat_pluginpref_set_str_real (hexchat_plugin *pl, const char *var, const char *value, int mode) /* mode: 0 = delete, 1 = save */
+/* Plugin preferences are kept in memory, one table per addon_<name>.conf
+   (scripts sharing a name share it), and written back a few seconds after
+   they last changed, or when a plugin is unloaded. */
+
+#define PLUGINPREF_SAVE_DELAY 2	/* seconds */
+
+typedef struct
+{
+	char *confname;		/* addon_<name>.conf */
+	GHashTable *values;	/* var -> unescaped value */
+	GQueue vars;		/* keys of values, in file order */
+	gboolean dirty;
+	GStatBuf st;		/* the file as we last read or wrote it */
+} pluginpref_store;
+
+static GHashTable *pluginpref_stores = NULL;	/* confname -> pluginpref_store */
+static int pluginpref_save_tag = 0;
+
+static void
+pluginpref_store_stat (const char *filename, GStatBuf *st)
 {
-	FILE *fpIn;
-	int fhOut;
-	int prevSetting;
-	char *confname;
-	char *confname_tmp;
-	char *escaped_value;
-	char *buffer;
-	char *buffer_tmp;
-	char line_buffer[512];		/* the same as in cfg_put_str */
-	char *line_bufp = line_buffer;
-	char *canon;
+	if (g_stat (filename, st) != 0)
+		memset (st, 0, sizeof (*st));
+}
+
+static void
+pluginpref_store_load (pluginpref_store *store, const char *filename)
+{
+	char *cfg, *line, *var, *value, *key;
+
+	g_queue_clear (&store->vars);
+	g_hash_table_remove_all (store->values);
+	pluginpref_store_stat (filename, &store->st);
+
+	if (g_file_get_contents (filename, &cfg, NULL, NULL))
+	{
+		line = cfg;
+		while ((line = cfg_next_pair (line, &var, &value)))
+		{
+			if (var && !g_hash_table_contains (store->values, var))
+			{
+				key = g_strdup (var);
+				g_hash_table_insert (store->values, key, g_strcompress (value));
+				g_queue_push_tail (&store->vars, key);
+			}
+		}
+		g_free (cfg);
+	}
+}
+
+static pluginpref_store *
+pluginpref_store_get (hexchat_plugin *pl)
+{
+	pluginpref_store *store;
+	GStatBuf st;
+	char *canon, *confname, *filename;
 
 	canon = g_strdup (pl->name);
 	canonalize_key (canon);
 	confname = g_strdup_printf ("addon_%s.conf", canon);
 	g_free (canon);
-	confname_tmp = g_strdup_printf ("%s.new", confname);
 
-	fhOut = hexchat_open_file (confname_tmp, O_TRUNC | O_WRONLY | O_CREAT, 0600, XOF_DOMODE);
-	fpIn = hexchat_fopen_file (confname, "r", 0);
+	if (!pluginpref_stores)
+		pluginpref_stores = g_hash_table_new (g_str_hash, g_str_equal);
+
+	filename = g_build_filename (get_xdir (), confname, NULL);
 
-	if (fhOut == -1)		/* unable to save, abort */
+	store = g_hash_table_lookup (pluginpref_stores, confname);
+	if (store)
 	{
+		/* pick up edits made by hand or by another instance, unless we
+		   have changes of our own still waiting to be written */
+		if (!store->dirty)
+		{
+			pluginpref_store_stat (filename, &st);
+			if (st.st_mtime != store->st.st_mtime || st.st_size != store->st.st_size ||
+				 st.st_ino != store->st.st_ino)
+				pluginpref_store_load (store, filename);
+		}
+		g_free (filename);
 		g_free (confname);
-		g_free (confname_tmp);
-		if (fpIn)
-			fclose (fpIn);
-		return 0;
+		return store;
 	}
-	else if (fpIn == NULL)	/* no previous config file, no parsing */
+
+	store = g_new0 (pluginpref_store, 1);
+	store->confname = confname;
+	store->values = casemap_hash_table_new ((void *)g_ascii_strcasecmp, g_free, g_free);
+	g_queue_init (&store->vars);
+	pluginpref_store_load (store, filename);
+	g_free (filename);
+
+	g_hash_table_insert (pluginpref_stores, store->confname, store);
+	return store;
+}
+
+/* write the whole table to a .new file and rename it over the old one */
+
+static int
+pluginpref_store_save (pluginpref_store *store)
+{
+	GString *out;
+	GList *list;
+	char *escaped, *confname_tmp, *filename, *filename_tmp;
+	gssize written;
+	int fh, ok;
+
+	store->dirty = FALSE;
+
+	out = g_string_new (NULL);
+	for (list = store->vars.head; list; list = list->next)
 	{
-		if (mode)
-		{
-			escaped_value = g_strescape (value, NULL);
-			buffer = g_strdup_printf ("%s = %s\n", var, escaped_value);
-			g_free (escaped_value);
-			write (fhOut, buffer, strlen (buffer));
-			g_free (buffer);
-			close (fhOut);
-
-			buffer = g_build_filename (get_xdir (), confname, NULL);
-			g_free (confname);
-			buffer_tmp = g_build_filename (get_xdir (), confname_tmp, NULL);
-			g_free (confname_tmp);
+		escaped = g_strescape (g_hash_table_lookup (store->values, list->data), NULL);
+		g_string_append_printf (out, "%s = %s\n", (char *)list->data, escaped);
+		g_free (escaped);
+	}
+
+	confname_tmp = g_strdup_printf ("%s.new", store->confname);
+	fh = hexchat_open_file (confname_tmp, O_TRUNC | O_WRONLY | O_CREAT, 0600, XOF_DOMODE);
+	g_free (confname_tmp);
+	filename = g_build_filename (get_xdir (), store->confname, NULL);
+	filename_tmp = g_strdup_printf ("%s.new", filename);
+
+	if (fh == -1)
+	{
+		ok = FALSE;
+	}
+	else
+	{
+		written = write (fh, out->str, out->len);
+		ok = written == (gssize) out->len;
+		close (fh);
 
+		if (ok)
+		{
 #ifdef WIN32
-			g_unlink (buffer);
+			g_unlink (filename);
 #endif
-
-			if (g_rename (buffer_tmp, buffer) == 0)
-			{
-				g_free (buffer);
-				g_free (buffer_tmp);
-				return 1;
-			}
-			else
-			{
-				g_free (buffer);
-				g_free (buffer_tmp);
-				return 0;
-			}
+			ok = g_rename (filename_tmp, filename) == 0;
 		}
 		else
 		{
-			/* mode = 0, we want to delete but the config file and thus the given setting does not exist, we're ready */
-			close (fhOut);
-			g_free (confname);
-			g_free (confname_tmp);
-			return 1;
+			g_unlink (filename_tmp);
 		}
 	}
-	else	/* existing config file, preserve settings and find & replace current var value if any */
-	{
-		prevSetting = 0;
-
-		while (fscanf (fpIn, " %511[^\n]", line_bufp) != EOF)	/* read whole lines including whitespaces */
-		{
-			buffer_tmp = g_strdup_printf ("%s ", var);	/* add one space, this way it works against var - var2 checks too */
+	g_string_free (out, TRUE);
 
-			if (strncmp (buffer_tmp, line_buffer, strlen (var) + 1) == 0)	/* given setting already exists */
-			{
-				if (mode)									/* overwrite the existing matching setting if we are in save mode */
-				{
-					escaped_value = g_strescape (value, NULL);
-					buffer = g_strdup_printf ("%s = %s\n", var, escaped_value);
-					g_free (escaped_value);
-				}
-				else										/* erase the setting in delete mode */
-				{
-					buffer = g_strdup ("");
-				}
+	if (ok)
+	{
+		pluginpref_store_stat (filename, &store->st);
+	}
+	else
+	{
+		/* the changes stay in memory, try again when the plugin unloads */
+		store->dirty = TRUE;
+		PrintTextf (NULL, _("Could not save plugin preferences to %s\n"), filename);
+	}
 
-				prevSetting = 1;
-			}
-			else
-			{
-				buffer = g_strdup_printf ("%s\n", line_buffer);	/* preserve the existing different settings */
-			}
+	g_free (filename);
+	g_free (filename_tmp);
+	return ok;
+}
 
-			write (fhOut, buffer, strlen (buffer));
+void
+pluginpref_flush (void)
+{
+	GHashTableIter iter;
+	gpointer store;
 
-			g_free (buffer);
-			g_free (buffer_tmp);
-		}
+	if (pluginpref_save_tag)
+	{
+		fe_timeout_remove (pluginpref_save_tag);
+		pluginpref_save_tag = 0;
+	}
 
-		fclose (fpIn);
+	if (!pluginpref_stores)
+		return;
 
-		if (!prevSetting && mode)	/* var doesn't exist currently, append if we're in save mode */
-		{
-			escaped_value = g_strescape (value, NULL);
-			buffer = g_strdup_printf ("%s = %s\n", var, escaped_value);
-			g_free (escaped_value);
-			write (fhOut, buffer, strlen (buffer));
-			g_free (buffer);
-		}
+	g_hash_table_iter_init (&iter, pluginpref_stores);
+	while (g_hash_table_iter_next (&iter, NULL, &store))
+	{
+		if (((pluginpref_store *)store)->dirty)
+			pluginpref_store_save (store);
+	}
+}
 
-		close (fhOut);
+static int
+pluginpref_save_timeout (void *unused)
+{
+	pluginpref_save_tag = 0;
+	pluginpref_flush ();
+	return 0;
+}
 
-		buffer = g_build_filename (get_xdir (), confname, NULL);
-		g_free (confname);
-		buffer_tmp = g_build_filename (get_xdir (), confname_tmp, NULL);
-		g_free (confname_tmp);
+static int
+hexchat_pluginpref_set_str_real (hexchat_plugin *pl, const char *var, const char *value, int mode) /* mode: 0 = delete, 1 = save */
+{
+	pluginpref_store *store;
+	gpointer key, old;
 
-#ifdef WIN32
-		g_unlink (buffer);
-#endif
+	store = pluginpref_store_get (pl);
 
-		if (g_rename (buffer_tmp, buffer) == 0)
-		{
-			g_free (buffer);
-			g_free (buffer_tmp);
+	if (!g_hash_table_lookup_extended (store->values, var, &key, &old))
+	{
+		if (!mode)
+			return 1;	/* deleting what isn't there */
+		key = g_strdup (var);
+		g_hash_table_insert (store->values, key, g_strdup (value));
+		g_queue_push_tail (&store->vars, key);
+	}
+	else if (mode)
+	{
+		if (strcmp (old, value) == 0)
 			return 1;
-		}
-		else
-		{
-			g_free (buffer);
-			g_free (buffer_tmp);
-			return 0;
-		}
+		g_hash_table_insert (store->values, g_strdup (var), g_strdup (value));
+	}
+	else
+	{
+		g_queue_remove (&store->vars, key);
+		g_hash_table_remove (store->values, var);
 	}
+
+	store->dirty = TRUE;
+	if (!pluginpref_save_tag)
+		pluginpref_save_tag = fe_timeout_add_seconds (PLUGINPREF_SAVE_DELAY, pluginpref_save_timeout, NULL);
+
+	return 1;
 }
 
 int
@@ -1941,32 +2192,13 @@ hexchat_pluginpref_set_str (hexchat_plugin *pl, const char *var, const char *val
 static int
 hexchat_pluginpref_get_str_real (hexchat_plugin *pl, const char *var, char *dest, int dest_len)
 {
-	char *confname, *canon, *cfg, *unescaped_value;
-	char buf[512];
+	char *value;
 
-	canon = g_strdup (pl->name);
-	canonalize_key (canon);
-	confname = g_strdup_printf ("%s%caddon_%s.conf", get_xdir(), G_DIR_SEPARATOR, canon);
-	g_free (canon);
-
-	if (!g_file_get_contents (confname, &cfg, NULL, NULL))
-	{
-		g_free (confname);
+	value = g_hash_table_lookup (pluginpref_store_get (pl)->values, var);
+	if (!value)
 		return 0;
-	}
-	g_free (confname);
 
-	if (!cfg_get_str (cfg, var, buf, sizeof(buf)))
-	{
-		g_free (cfg);
-		return 0;
-	}
-
-	unescaped_value = g_strcompress (buf);
-	g_strlcpy (dest, unescaped_value, dest_len);
-
-	g_free (unescaped_value);
-	g_free (cfg);
+	g_strlcpy (dest, value, dest_len);
 	return 1;
 }
 
@@ -2016,34 +2248,18 @@ hexchat_pluginpref_delete (hexchat_plugin *pl, const char *var)
 int
 hexchat_pluginpref_list (hexchat_plugin *pl, char* dest)
 {
-	FILE *fpIn;
-	char confname[64];
-	char buffer[512];										/* the same as in cfg_put_str */
-	char *bufp = buffer;
-	char *token;
-
-	token = g_strdup (pl->name);
-	canonalize_key (token);
-	sprintf (confname, "addon_%s.conf", token);
-	g_free (token);
+	pluginpref_store *store;
+	GList *list;
 
-	fpIn = hexchat_fopen_file (confname, "r", 0);
-
-	if (fpIn == NULL)										/* no existing config file, no parsing */
-	{
+	store = pluginpref_store_get (pl);
+	if (!store->vars.length)
 		return 0;
-	}
-	else													/* existing config file, get list of settings */
-	{
-		strcpy (dest, "");									/* clean up garbage */
-		while (fscanf (fpIn, " %511[^\n]", bufp) != EOF)	/* read whole lines including whitespaces */
-		{
-			token = strtok (buffer, "=");
-			g_strlcat (dest, g_strchomp (token), 4096); /* Dest must not be smaller than this */
-			g_strlcat (dest, ",", 4096);
-		}
 
-		fclose (fpIn);
+	strcpy (dest, "");
+	for (list = store->vars.head; list; list = list->next)
+	{
+		g_strlcat (dest, list->data, 4096); /* Dest must not be smaller than this */
+		g_strlcat (dest, ",", 4096);
 	}
 
 	return 1;
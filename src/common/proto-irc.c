@@ -455,8 +455,8 @@ static void process_numeric(session *sess, int n, char *word[],
       goto def;
 
   case 303:
-    word[4]++;
-    notify_markonline(serv, word, tags_data);
+    notify_markonline(serv, word_eol[4][0] == ':' ? word_eol[4] + 1 : word_eol[4],
+                      tags_data);
     break;
 
   case 305:
@@ -1432,9 +1432,13 @@ static void irc_inline(server *serv, char *buf, int len) {
   char *word[PDIWORDS + 1];
   char *word_eol[PDIWORDS + 1];
   char *pdibuf;
+  char pdibuf_static[522]; /* enough for most lines without tags */
   message_tags_data tags_data = MESSAGE_TAGS_DATA_INIT;
 
-  pdibuf = g_malloc(len + 1);
+  if (len < (int)sizeof(pdibuf_static))
+    pdibuf = pdibuf_static;
+  else
+    pdibuf = g_malloc(len + 1);
 
   sess = serv->front_session;
 
@@ -1505,7 +1509,8 @@ static void irc_inline(server *serv, char *buf, int len) {
 
 xit:
   message_tags_data_free(&tags_data);
-  g_free(pdibuf);
+  if (pdibuf != pdibuf_static)
+    g_free(pdibuf);
 }
 
 void message_tags_data_free(message_tags_data *tags_data) {
@@ -66,6 +66,9 @@
 static struct session *g_sess = NULL;
 #endif
 
+/* max lines to process per wakeup in server_read() */
+#define SERVER_READ_BATCH 200
+
 static GSList *away_list = NULL;
 GSList *serv_list = NULL;
 
@@ -73,6 +76,8 @@ static void auto_reconnect (server *serv, int send_quit, int err);
 static void server_disconnect (session * sess, int sendquit, int err);
 static int server_cleanup (server * serv);
 static void server_connect (server *serv, char *hostname, int port, int no_login);
+static void server_start_child (server *serv);
+static void server_dns_cache_forget (const char *hostname);
 
 static void
 write_error (char *message, GError **error)
@@ -282,17 +287,51 @@ static void
 server_inline (server *serv, char *line, gssize len)
 {
 	gsize len_utf8;
+	char *conv = NULL;
+
 	if (!strcmp (serv->encoding, "UTF-8"))
-		line = text_fixup_invalid_utf8 (line, len, &len_utf8);
+	{
+		/* valid input is passed on in place, g_utf8_validate() has a fast
+		   path for plain ASCII which is what most lines are */
+		if (g_utf8_validate (line, len, NULL))
+			len_utf8 = len;
+		else
+			line = conv = text_fixup_invalid_utf8 (line, len, &len_utf8);
+	}
 	else
-		line = text_convert_invalid (line, len, serv->read_converter, unicode_fallback_string, &len_utf8);
+		line = conv = text_convert_invalid (line, len, serv->read_converter, unicode_fallback_string, &len_utf8);
 
 	fe_add_rawlog (serv, line, len_utf8, FALSE);
 
 	/* let proto-irc.c handle it */
 	serv->p_inline (serv, line, len_utf8);
 
-	g_free (line);
+	g_free (conv);
+}
+
+/* remove the CRs from a line, normally only the one before the LF */
+
+static int
+server_strip_cr (char *line, int len)
+{
+	char *src, *dst;
+
+	while (len > 0 && line[len - 1] == '\r')
+		len--;
+
+	dst = memchr (line, '\r', len);
+	if (dst)
+	{
+		for (src = dst; src < line + len; src++)
+		{
+			if (*src != '\r')
+				*dst++ = *src;
+		}
+		len = dst - line;
+	}
+
+	line[len] = 0;
+	return len;
 }
 
 /* read data from socket */
@@ -301,18 +340,19 @@ static gboolean
 server_read (GIOChannel *source, GIOCondition condition, server *serv)
 {
 	int sok = serv->sok;
-	int error, i, len;
-	char lbuf[2050];
+	int error, len, lines = 0;
+	char *line, *scan, *eol, *end;
 
 	while (1)
 	{
+		/* read straight into linebuf, after any partial line left from last time */
 #ifdef USE_OPENSSL
 		if (!serv->ssl)
 #endif
-			len = recv (sok, lbuf, sizeof (lbuf) - 2, 0);
+			len = recv (sok, serv->linebuf + serv->pos, sizeof (serv->linebuf) - 1 - serv->pos, 0);
 #ifdef USE_OPENSSL
 		else
-			len = _SSL_recv (serv->ssl, lbuf, sizeof (lbuf) - 2);
+			len = _SSL_recv (serv->ssl, serv->linebuf + serv->pos, sizeof (serv->linebuf) - 1 - serv->pos);
 #endif
 		if (len < 1)
 		{
@@ -341,32 +381,61 @@ server_read (GIOChannel *source, GIOCondition condition, server *serv)
 			return TRUE;
 		}
 
-		i = 0;
-
-		lbuf[len] = 0;
+		line = serv->linebuf;
+		scan = line + serv->pos; /* the old part has no LF in it */
+		end = scan + len;
 
-		while (i < len)
+		while ((eol = memchr (scan, '\n', end - scan)))
 		{
-			switch (lbuf[i])
+			if (serv->linebuf_skip)
 			{
-			case '\r':
-				break;
-
-			case '\n':
-				serv->linebuf[serv->pos] = 0;
-				server_inline (serv, serv->linebuf, serv->pos);
-				serv->pos = 0;
-				break;
+				/* rest of an overlong line that was already handled */
+				serv->linebuf_skip = FALSE;
+			}
+			else
+			{
+				server_inline (serv, line, server_strip_cr (line, eol - line));
+				lines++;
 
-			default:
-				serv->linebuf[serv->pos] = lbuf[i];
-				if (serv->pos >= (sizeof (serv->linebuf) - 1))
-					fprintf (stderr,
-								"*** HEXCHAT WARNING: Buffer overflow - non-compliant server!\n");
-				else
-					serv->pos++;
+				/* the line may have got us disconnected */
+				if (serv->sok != sok || !serv->connected)
+					return TRUE;
 			}
-			i++;
+			line = scan = eol + 1;
+		}
+
+		serv->pos = end - line;
+		if (serv->linebuf_skip)
+		{
+			serv->pos = 0;
+		}
+		else if (serv->pos >= (int) sizeof (serv->linebuf) - 1)
+		{
+			fprintf (stderr,
+						"*** HEXCHAT WARNING: Buffer overflow - non-compliant server!\n");
+			/* pass on what we have and drop the rest up to the next LF */
+			serv->pos = 0;
+			serv->linebuf_skip = TRUE;
+			server_inline (serv, line, server_strip_cr (line, end - line));
+			lines++;
+
+			if (serv->sok != sok || !serv->connected)
+				return TRUE;
+		}
+		else if (serv->pos > 0 && line != serv->linebuf)
+		{
+			memmove (serv->linebuf, line, serv->pos);
+		}
+
+		/* let the main loop breathe during big bursts (e.g. bouncer playback),
+		   we'll be called again while the socket is still readable */
+		if (lines >= SERVER_READ_BATCH)
+		{
+#ifdef USE_OPENSSL
+			/* data already decrypted by OpenSSL doesn't wake up the main loop */
+			if (!serv->ssl || !SSL_pending (serv->ssl))
+#endif
+				return TRUE;
 		}
 	}
 }
@@ -437,15 +506,28 @@ server_stopconnecting (server * serv)
 		serv->joindelay_tag = 0;
 	}
 
+	if (serv->resolving)
+	{
+		/* server_resolved() won't touch serv after this */
+		g_cancellable_cancel (serv->resolving);
+		g_clear_object (&serv->resolving);
+	}
+
 #ifndef WIN32
-	/* kill the child process trying to connect */
-	kill (serv->childpid, SIGKILL);
-	waitpid (serv->childpid, NULL, 0);
+	/* kill the child process trying to connect, if it got that far */
+	if (serv->childpid)
+	{
+		kill (serv->childpid, SIGKILL);
+		waitpid (serv->childpid, NULL, 0);
+		serv->childpid = 0;
+	}
 
 	close (serv->childwrite);
 	close (serv->childread);
 #else
-	PostThreadMessage (serv->childpid, WM_QUIT, 0, 0);
+	if (serv->childpid)
+		PostThreadMessage (serv->childpid, WM_QUIT, 0, 0);
+	serv->childpid = 0;
 
 	{
 		/* if we close the pipe now, giowin32 will crash. */
@@ -830,6 +912,7 @@ server_read_child (GIOChannel *source, GIOCondition condition, server *serv)
 		break;
 	case '2':						  /* connection failed */
 		waitline2 (source, tbuf, sizeof tbuf);
+		server_dns_cache_forget (serv->hostname);	/* maybe it moved */
 		server_stopconnecting (serv);
 		closesocket (serv->sok4);
 		if (serv->proxy_sok4 != -1)
@@ -1026,11 +1109,13 @@ server_disconnect (session * sess, int sendquit, int err)
 	}
 
 	serv->pos = 0;
+	serv->linebuf_skip = FALSE;
 	serv->motd_skipped = FALSE;
 	serv->no_login = FALSE;
 	serv->servername[0] = 0;
 	serv->lag_sent = 0;
 
+	notify_server_reset (serv);
 	notify_cleanup ();
 }
 
@@ -1371,6 +1456,7 @@ server_child (server * serv)
 	int proxy_type = 0;
 	char *proxy_host = NULL;
 	int proxy_port;
+	GPtrArray *addrs = NULL;
 
 	ns_server = net_store_new ();
 
@@ -1473,11 +1559,22 @@ server_child (server * serv)
 			proxy_ip = g_strdup (hostname);
 	} else
 	{
-		ip = net_resolve (ns_server, hostname, port, &real_hostname);
-		if (!ip)
+		/* the parent may have looked it up for us already */
+		addrs = serv->resolved;
+		serv->resolved = NULL;
+		if (addrs)
 		{
-			write (serv->childwrite, "1\n", 2);
-			goto xit;
+			ip = serv->resolved_ip;
+			serv->resolved_ip = NULL;
+			real_hostname = g_strdup (hostname);
+		} else
+		{
+			ip = net_resolve (ns_server, hostname, port, &real_hostname);
+			if (!ip)
+			{
+				write (serv->childwrite, "1\n", 2);
+				goto xit;
+			}
 		}
 		connect_port = port;
 	}
@@ -1488,7 +1585,11 @@ server_child (server * serv)
 
 	if (!serv->dont_use_proxy && (proxy_type == 5))
 		error = net_connect (ns_server, serv->proxy_sok4, serv->proxy_sok6, &psok);
-	else
+	else if (addrs)
+	{
+		error = net_connect_race (addrs, serv->sok4, serv->sok6, &sok);
+		psok = sok;
+	} else
 	{
 		error = net_connect (ns_server, serv->sok4, serv->sok6, &sok);
 		psok = sok;
@@ -1533,16 +1634,148 @@ xit:
 	g_free (proxy_ip);
 	g_free (ip);
 	g_free (real_hostname);
+	if (addrs)
+		g_ptr_array_free (addrs, TRUE);
 #endif
 
 	return 0;
 	/* cppcheck-suppress memleak */
 }
 
+/* Lookups done in the parent, for direct connections only. The child
+ * resolves by itself when a proxy or the system resolver decides. */
+
+#define DNS_CACHE_TTL 300	/* seconds, the resolver doesn't tell us the real one */
+
+struct dns_cache_entry
+{
+	GList *addrs;
+	gint64 expires;
+};
+
+static GHashTable *dns_cache = NULL;
+
+static void
+server_dns_cache_entry_free (struct dns_cache_entry *entry)
+{
+	g_resolver_free_addresses (entry->addrs);
+	g_free (entry);
+}
+
+static GList *
+server_dns_cache_lookup (const char *hostname)
+{
+	struct dns_cache_entry *entry;
+
+	if (!dns_cache)
+		return NULL;
+
+	entry = g_hash_table_lookup (dns_cache, hostname);
+	if (!entry)
+		return NULL;
+
+	if (entry->expires < g_get_monotonic_time ())
+	{
+		g_hash_table_remove (dns_cache, hostname);
+		return NULL;
+	}
+
+	return g_list_copy_deep (entry->addrs, (GCopyFunc)g_object_ref, NULL);
+}
+
+static void
+server_dns_cache_store (const char *hostname, GList *addrs)
+{
+	struct dns_cache_entry *entry;
+
+	if (!dns_cache)
+		dns_cache = casemap_hash_table_new ((void *)g_ascii_strcasecmp, g_free,
+						(GDestroyNotify)server_dns_cache_entry_free);
+
+	entry = g_new (struct dns_cache_entry, 1);
+	entry->addrs = g_list_copy_deep (addrs, (GCopyFunc)g_object_ref, NULL);
+	entry->expires = g_get_monotonic_time () + DNS_CACHE_TTL * G_USEC_PER_SEC;
+	g_hash_table_replace (dns_cache, g_strdup (hostname), entry);
+}
+
+static void
+server_dns_cache_forget (const char *hostname)
+{
+	if (dns_cache)
+		g_hash_table_remove (dns_cache, hostname);
+}
+
+static void
+server_clear_resolved (server *serv)
+{
+	if (serv->resolved)
+	{
+		g_ptr_array_free (serv->resolved, TRUE);
+		serv->resolved = NULL;
+	}
+	g_free (serv->resolved_ip);
+	serv->resolved_ip = NULL;
+}
+
+/* server_child() gets plain sockaddrs: it's forked while GLib's resolver
+   threads may hold locks, so it mustn't call into GObject */
+static void
+server_set_resolved (server *serv, GList *addrs)
+{
+	server_clear_resolved (serv);
+	serv->resolved = net_addresses_to_native (addrs, serv->port);
+	serv->resolved_ip = g_inet_address_to_string (addrs->data);
+}
+
+/* would server_child() connect straight to serv->hostname? */
+static gboolean
+server_use_resolver (server *serv)
+{
+	if (serv->dont_use_proxy || prefs.hex_net_proxy_type == 0)
+		return TRUE;
+
+	/* type 5 asks the system, which might still say "direct" */
+	if (prefs.hex_net_proxy_type == 5)
+		return FALSE;
+
+	return !prefs.hex_net_proxy_host[0] || prefs.hex_net_proxy_use == 2;
+}
+
+static void
+server_resolved (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	server *serv = user_data;
+	GError *error = NULL;
+	GList *addrs;
+
+	addrs = g_resolver_lookup_by_name_finish (G_RESOLVER (source), result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	{
+		/* serv may be gone */
+		g_error_free (error);
+		return;
+	}
+
+	g_clear_object (&serv->resolving);
+
+	if (!addrs)
+	{
+		g_error_free (error);
+		/* let server_read_child report it like the child would have */
+		write (serv->childwrite, "1\n", 2);
+		return;
+	}
+
+	server_dns_cache_store (serv->hostname, addrs);
+	server_set_resolved (serv, addrs);
+	g_resolver_free_addresses (addrs);
+	server_start_child (serv);
+}
+
 static void
 server_connect (server *serv, char *hostname, int port, int no_login)
 {
-	int pid, read_des[2];
+	int read_des[2];
 	session *sess = serv->server_session;
 
 #ifdef USE_OPENSSL
@@ -1637,6 +1870,39 @@ server_connect (server *serv, char *hostname, int port, int no_login)
 	serv->proxy_sok4 = -1;
 	serv->proxy_sok6 = -1;
 
+#ifdef WIN32
+	serv->iotag = fe_input_add (serv->childread, FIA_READ|FIA_FD, server_read_child,
+#else
+	serv->iotag = fe_input_add (serv->childread, FIA_READ, server_read_child,
+#endif
+										 serv);
+
+	serv->childpid = 0;
+	if (server_use_resolver (serv))
+	{
+		GList *addrs = server_dns_cache_lookup (serv->hostname);
+
+		if (addrs)
+		{
+			server_set_resolved (serv, addrs);
+			g_resolver_free_addresses (addrs);
+		} else
+		{
+			serv->resolving = g_cancellable_new ();
+			g_resolver_lookup_by_name_async (g_resolver_get_default (), serv->hostname,
+														serv->resolving, server_resolved, serv);
+			return;
+		}
+	}
+
+	server_start_child (serv);
+}
+
+static void
+server_start_child (server *serv)
+{
+	int pid;
+
 #ifdef WIN32
 	CloseHandle (CreateThread (NULL, 0,
 										(LPTHREAD_START_ROUTINE)server_child,
@@ -1660,14 +1926,11 @@ server_connect (server *serv, char *hostname, int port, int no_login)
 		server_child (serv);
 		_exit (0);
 	}
+
+	/* the child has its own copy */
+	server_clear_resolved (serv);
 #endif
 	serv->childpid = pid;
-#ifdef WIN32
-	serv->iotag = fe_input_add (serv->childread, FIA_READ|FIA_FD, server_read_child,
-#else
-	serv->iotag = fe_input_add (serv->childread, FIA_READ, server_read_child,
-#endif
-										 serv);
 }
 
 void
@@ -1930,6 +2193,13 @@ server_free (server *serv)
 	g_free (serv->bad_nick_prefixes);
 	g_free (serv->last_away_reason);
 	g_free (serv->encoding);
+	if (serv->user_sessions)
+		g_hash_table_destroy (serv->user_sessions);
+	if (serv->channels)
+		g_hash_table_destroy (serv->channels);
+	inbound_netsplit_free (serv);
+	notify_server_reset (serv);
+	server_clear_resolved (serv);
 
 	g_iconv_close (serv->read_converter);
 	g_iconv_close (serv->write_converter);
@@ -67,6 +67,12 @@ static ca_context *ca_con;
 
 #define SCROLLBACK_MAX 32000
 
+#define LOG_FLUSH_SIZE 8192   /* bytes buffered per session before writing */
+#define LOG_FLUSH_INTERVAL 2  /* seconds until buffered log lines are written */
+#define LOG_CHECK_INTERVAL 60 /* seconds between checks of the log path */
+
+static int log_flush_tag = 0;
+
 static void mkdir_p(char *filename);
 static char *log_create_filename(char *channame);
 
@@ -102,53 +108,67 @@ static char *scrollback_get_filename(session *sess) {
   return ret;
 }
 
-void scrollback_close(session *sess) { g_clear_object(&sess->scrollfile); }
+/* the scrollback is kept in two segments: new lines are appended to
+   <chan>.txt, and once that holds max_lines lines it's renamed to
+   <chan>.txt.old, replacing the previous one. Trimming never rewrites
+   the file and the newest max_lines lines are always on disk. */
 
-/* shrink the file to roughly prefs.hex_text_max_lines */
+static gint scrollback_max_lines(void) {
+  if (prefs.hex_text_max_lines > 0)
+    return MIN(prefs.hex_text_max_lines, SCROLLBACK_MAX);
+  return SCROLLBACK_MAX;
+}
 
-static void scrollback_shrink(session *sess) {
-  char *buf, *p;
-  gsize len;
-  gint offset, lines = 0;
-  const gint max_lines = MIN(prefs.hex_text_max_lines, SCROLLBACK_MAX);
+static gboolean scrollback_open(session *sess) {
+  char *buf;
 
-  if (!g_file_load_contents(sess->scrollfile, NULL, &buf, &len, NULL, NULL))
-    return;
+  if (sess->scrollfile)
+    return TRUE;
 
-  /* count all lines */
-  p = buf;
-  while (p != buf + len) {
-    if (*p == '\n')
-      lines++;
-    p++;
-  }
+  if ((buf = scrollback_get_filename(sess)) == NULL)
+    return FALSE;
 
-  offset = lines - max_lines;
+  sess->scrollfile = g_file_new_for_path(buf);
+  g_free(buf);
 
-  /* now just go back to where we want to start the file */
-  p = buf;
-  lines = 0;
-  while (p != buf + len) {
-    if (*p == '\n') {
-      lines++;
-      if (lines == offset) {
-        p++;
-        break;
-      }
-    }
-    p++;
-  }
+  return TRUE;
+}
 
-  if (g_file_replace_contents(sess->scrollfile, p, strlen(p), NULL, FALSE,
-                              G_FILE_CREATE_PRIVATE, NULL, NULL, NULL))
-    sess->scrollwritten = lines;
+static GFile *scrollback_get_old_file(session *sess) {
+  GFile *file;
+  char *path, *old;
 
-  g_free(buf);
+  path = g_file_get_path(sess->scrollfile);
+  old = g_strconcat(path, ".old", NULL);
+  file = g_file_new_for_path(old);
+  g_free(old);
+  g_free(path);
+
+  return file;
+}
+
+void scrollback_close(session *sess) {
+  g_clear_object(&sess->scrollstream);
+  g_clear_object(&sess->scrollfile);
+}
+
+/* start a new segment, dropping the oldest one */
+
+static void scrollback_rotate(session *sess) {
+  GFile *old;
+
+  g_clear_object(&sess->scrollstream);
+
+  old = scrollback_get_old_file(sess);
+  g_file_move(sess->scrollfile, old, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL,
+              NULL);
+  g_object_unref(old);
+
+  sess->scrollsegment = 0;
 }
 
 static void scrollback_save(session *sess, char *text, time_t stamp) {
-  GOutputStream *ostream;
-  char *buf;
+  GString *line;
 
   if (sess->type == SESS_SERVER && prefs.hex_gui_tab_server == 1)
     return;
@@ -161,151 +181,249 @@ static void scrollback_save(session *sess, char *text, time_t stamp) {
       return;
   }
 
-  if (!sess->scrollfile) {
-    if ((buf = scrollback_get_filename(sess)) == NULL)
-      return;
+  if (!scrollback_open(sess))
+    return;
 
-    sess->scrollfile = g_file_new_for_path(buf);
-    g_free(buf);
-  } else {
+  if (sess->scrollsegment >= scrollback_max_lines())
+    scrollback_rotate(sess);
+
+  if (!sess->scrollstream) {
     /* Users can delete the folder after it's created... */
     GFile *parent = g_file_get_parent(sess->scrollfile);
     g_file_make_directory_with_parents(parent, NULL, NULL);
     g_object_unref(parent);
-  }
 
-  ostream = G_OUTPUT_STREAM(
-      g_file_append_to(sess->scrollfile, G_FILE_CREATE_PRIVATE, NULL, NULL));
-  if (!ostream)
-    return;
+    sess->scrollstream = G_OUTPUT_STREAM(
+        g_file_append_to(sess->scrollfile, G_FILE_CREATE_PRIVATE, NULL, NULL));
+    if (!sess->scrollstream)
+      return;
+  }
 
   if (!stamp)
     stamp = time(0);
+
+  line = g_string_sized_new(strlen(text) + 24);
   if (sizeof(stamp) == 4) /* gcc will optimize one of these out */
-    buf = g_strdup_printf("T %d ", (int)stamp);
+    g_string_printf(line, "T %d ", (int)stamp);
   else
-    buf = g_strdup_printf("T %" G_GINT64_FORMAT " ", (gint64)stamp);
-
-  g_output_stream_write(ostream, buf, strlen(buf), NULL, NULL);
-  g_output_stream_write(ostream, text, strlen(text), NULL, NULL);
+    g_string_printf(line, "T %" G_GINT64_FORMAT " ", (gint64)stamp);
+  g_string_append(line, text);
   if (!g_str_has_suffix(text, "\n"))
-    g_output_stream_write(ostream, "\n", 1, NULL, NULL);
+    g_string_append_c(line, '\n');
 
-  g_free(buf);
-  g_object_unref(ostream);
+  if (!g_output_stream_write_all(sess->scrollstream, line->str, line->len, NULL,
+                                 NULL, NULL))
+    g_clear_object(&sess->scrollstream); /* try to reopen next time */
 
-  sess->scrollwritten++;
+  g_string_free(line, TRUE);
 
-  if ((sess->scrollwritten > prefs.hex_text_max_lines &&
-       prefs.hex_text_max_lines > 0) ||
-      sess->scrollwritten > SCROLLBACK_MAX)
-    scrollback_shrink(sess);
+  sess->scrollsegment++;
+  sess->scrollwritten++;
 }
 
-void scrollback_load(session *sess) {
-  GInputStream *stream;
-  GDataInputStream *istream;
-  gchar *buf, *text;
-  gint lines = 0;
-  time_t stamp = 0;
+#define SCROLLBACK_READ_BLOCK 32768
 
-  if (sess->text_scrollback == SET_DEFAULT) {
-    if (!prefs.hex_text_replay)
-      return;
-  } else {
-    if (sess->text_scrollback != SET_ON)
-      return;
-  }
+/* read the last max_lines lines of a file by scanning it backwards from the
+   end, so a big file doesn't have to be streamed through. Returns the text
+   and the number of lines in it in *lines_out. */
 
-  if (!sess->scrollfile) {
-    if ((buf = scrollback_get_filename(sess)) == NULL)
-      return;
+static char *scrollback_read_tail(GFile *file, gint max_lines, gsize *len_out,
+                                  gint *lines_out) {
+  GFileInputStream *stream;
+  GFileInfo *info;
+  goffset size, pos, start = 0;
+  char *block, *buf = NULL;
+  gsize i, n;
+  gint found = 0;
 
-    sess->scrollfile = g_file_new_for_path(buf);
-    g_free(buf);
-  }
+  *len_out = 0;
+  *lines_out = 0;
+
+  if (max_lines <= 0)
+    return NULL;
 
-  stream = G_INPUT_STREAM(g_file_read(sess->scrollfile, NULL, NULL));
+  stream = g_file_read(file, NULL, NULL);
   if (!stream)
-    return;
+    return NULL;
 
-  istream = g_data_input_stream_new(stream);
-  /*
-   * This is to avoid any issues moving between windows/unix
-   * but the docs mention an invalid \r without a following \n
-   * can lock up the program... (Our write() always adds \n)
-   */
-  g_data_input_stream_set_newline_type(istream, G_DATA_STREAM_NEWLINE_TYPE_ANY);
-  g_object_unref(stream);
+  info = g_file_input_stream_query_info(stream, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                        NULL, NULL);
+  if (!info) {
+    g_object_unref(stream);
+    return NULL;
+  }
+  size = g_file_info_get_size(info);
+  g_object_unref(info);
 
-  while (1) {
-    GError *err = NULL;
-    gsize n_bytes;
-
-    buf = g_data_input_stream_read_line_utf8(istream, &n_bytes, NULL, &err);
-
-    if (!err && buf) {
-      /*
-       * Some scrollback lines have three blanks after the timestamp and a
-       * newline Some have only one blank and a newline Some don't even have a
-       * timestamp Some don't have any text at all
-       */
-      if (buf[0] == 'T' && buf[1] == ' ') {
-        if (sizeof(time_t) == 4)
-          stamp = strtoul(buf + 2, NULL, 10);
-        else
-          stamp = g_ascii_strtoull(buf + 2, NULL,
-                                   10); /* in case time_t is 64 bits */
+  if (size <= 0) {
+    g_object_unref(stream);
+    return NULL;
+  }
 
-        if (G_UNLIKELY(stamp == 0)) {
-          g_warning("Invalid timestamp in scrollback file");
-          continue;
-        }
+  block = g_malloc(SCROLLBACK_READ_BLOCK);
+  pos = size;
 
-        text = strchr(buf + 3, ' ');
-        if (text && text[1]) {
-          if (prefs.hex_text_stripcolor_replay) {
-            text = strip_color(text + 1, -1, STRIP_COLOR);
-          }
+  /* count line ends backwards, ignoring the one at the very end */
+  while (pos > 0 && !start) {
+    n = MIN(pos, SCROLLBACK_READ_BLOCK);
+    pos -= n;
 
-          fe_print_text(sess, text, stamp, TRUE);
+    if (!g_seekable_seek(G_SEEKABLE(stream), pos, G_SEEK_SET, NULL, NULL) ||
+        !g_input_stream_read_all(G_INPUT_STREAM(stream), block, n, &n, NULL,
+                                 NULL))
+      goto xit;
 
-          if (prefs.hex_text_stripcolor_replay) {
-            g_free(text);
-          }
-        } else {
-          fe_print_text(sess, "  ", stamp, TRUE);
+    for (i = n; i > 0; i--) {
+      if (block[i - 1] == '\n' && pos + i != size) {
+        if (++found == max_lines) {
+          start = pos + i;
+          break;
         }
-      } else {
-        if (strlen(buf))
-          fe_print_text(sess, buf, 0, TRUE);
-        else
-          fe_print_text(sess, "  ", 0, TRUE);
       }
-      lines++;
+    }
+  }
 
-      g_free(buf);
-    } else if (err) {
-      /* If its only an encoding error it may be specific to the line */
-      if (g_error_matches(err, G_CONVERT_ERROR,
-                          G_CONVERT_ERROR_ILLEGAL_SEQUENCE)) {
-        g_warning("Invalid utf8 in scrollback file");
-        g_clear_error(&err);
+  if (!g_seekable_seek(G_SEEKABLE(stream), start, G_SEEK_SET, NULL, NULL))
+    goto xit;
+
+  n = size - start;
+  buf = g_malloc(n + 1);
+  if (!g_input_stream_read_all(G_INPUT_STREAM(stream), buf, n, &n, NULL,
+                               NULL)) {
+    g_clear_pointer(&buf, g_free);
+    goto xit;
+  }
+  buf[n] = 0;
+
+  *len_out = n;
+  *lines_out = start ? found : found + 1;
+
+xit:
+  g_free(block);
+  g_object_unref(stream);
+
+  return buf;
+}
+
+/* print the lines of a scrollback segment, returns the number printed */
+
+static gint scrollback_print_lines(session *sess, char *buf, gsize len,
+                                   time_t *stamp_out) {
+  char *line, *end, *eol, *text;
+  time_t stamp = 0;
+  gint lines = 0;
+
+  line = buf;
+  end = buf + len;
+
+  while (line < end) {
+    eol = memchr(line, '\n', end - line);
+    if (!eol)
+      eol = end;
+    *eol = 0;
+
+    /* in case the file went through windows */
+    if (eol > line && eol[-1] == '\r')
+      eol[-1] = 0;
+
+    if (!g_utf8_validate(line, -1, NULL)) {
+      g_warning("Invalid utf8 in scrollback file");
+      line = eol + 1;
+      continue;
+    }
+
+    /*
+     * Some scrollback lines have three blanks after the timestamp and a
+     * newline Some have only one blank and a newline Some don't even have a
+     * timestamp Some don't have any text at all
+     */
+    if (line[0] == 'T' && line[1] == ' ') {
+      if (sizeof(time_t) == 4)
+        stamp = strtoul(line + 2, NULL, 10);
+      else
+        stamp = g_ascii_strtoull(line + 2, NULL,
+                                 10); /* in case time_t is 64 bits */
+
+      if (G_UNLIKELY(stamp == 0)) {
+        g_warning("Invalid timestamp in scrollback file");
+        line = eol + 1;
         continue;
       }
 
-      /* For general errors just give up */
-      g_clear_error(&err);
-      break;
-    } else /* No new line */
-    {
-      break;
+      text = strchr(line + 3, ' ');
+      if (text && text[1]) {
+        if (prefs.hex_text_stripcolor_replay) {
+          text = strip_color(text + 1, -1, STRIP_COLOR);
+        }
+
+        fe_print_text(sess, text, stamp, TRUE);
+
+        if (prefs.hex_text_stripcolor_replay) {
+          g_free(text);
+        }
+      } else {
+        fe_print_text(sess, "  ", stamp, TRUE);
+      }
+    } else {
+      if (line[0])
+        fe_print_text(sess, line, 0, TRUE);
+      else
+        fe_print_text(sess, "  ", 0, TRUE);
     }
+    lines++;
+
+    line = eol + 1;
+  }
+
+  if (stamp)
+    *stamp_out = stamp;
+
+  return lines;
+}
+
+void scrollback_load(session *sess) {
+  GFile *old;
+  gchar *buf, *oldbuf, *text;
+  gsize len, oldlen;
+  gint lines, oldlines = 0;
+  gint max_lines = scrollback_max_lines();
+  time_t stamp = 0;
+
+  if (sess->text_scrollback == SET_DEFAULT) {
+    if (!prefs.hex_text_replay)
+      return;
+  } else {
+    if (sess->text_scrollback != SET_ON)
+      return;
+  }
+
+  if (!scrollback_open(sess))
+    return;
+
+  buf = scrollback_read_tail(sess->scrollfile, max_lines, &len, &lines);
+
+  /* not enough in the current segment, take the rest from the old one */
+  oldbuf = NULL;
+  if (lines < max_lines) {
+    old = scrollback_get_old_file(sess);
+    oldbuf = scrollback_read_tail(old, max_lines - lines, &oldlen, &oldlines);
+    g_object_unref(old);
   }
 
-  g_object_unref(istream);
+  /* the old segment's lines count as written too, only the current one
+     decides when to rotate */
+  sess->scrollsegment = lines;
+  sess->scrollwritten = lines + oldlines;
 
-  sess->scrollwritten = lines;
+  lines = 0;
+  if (oldbuf) {
+    lines += scrollback_print_lines(sess, oldbuf, oldlen, &stamp);
+    g_free(oldbuf);
+  }
+  if (buf) {
+    lines += scrollback_print_lines(sess, buf, len, &stamp);
+    g_free(buf);
+  }
 
   if (lines) {
     text = ctime(&stamp);
@@ -316,11 +434,68 @@ void scrollback_load(session *sess) {
   }
 }
 
+/* write out the lines buffered by log_append() */
+
+static void log_flush(session *sess) {
+  gsize done = 0;
+  int len;
+
+  if (!sess->logbuf || !sess->logbuf->len)
+    return;
+
+  if (sess->logfd != -1) {
+    while (done < sess->logbuf->len) {
+      len = write(sess->logfd, sess->logbuf->str + done,
+                  sess->logbuf->len - done);
+      if (len <= 0) {
+        sess->logcheck = 0; /* look for the file again on the next line */
+        break;
+      }
+      done += len;
+    }
+  }
+
+  g_string_truncate(sess->logbuf, 0);
+}
+
+void log_flush_all(void) {
+  GSList *list;
+
+  for (list = sess_list; list; list = list->next)
+    log_flush(list->data);
+}
+
+static int log_flush_timeout(gpointer unused) {
+  log_flush_tag = 0;
+  log_flush_all();
+
+  return 0;
+}
+
+void log_append(session *sess, const char *text, gssize len) {
+  if (sess->logfd == -1)
+    return;
+
+  if (len < 0)
+    len = strlen(text);
+
+  if (!sess->logbuf)
+    sess->logbuf = g_string_sized_new(LOG_FLUSH_SIZE);
+  g_string_append_len(sess->logbuf, text, len);
+
+  if (sess->logbuf->len >= LOG_FLUSH_SIZE)
+    log_flush(sess);
+  else if (!log_flush_tag)
+    log_flush_tag =
+        fe_timeout_add_seconds(LOG_FLUSH_INTERVAL, log_flush_timeout, NULL);
+}
+
 void log_close(session *sess) {
   char obuf[512];
   time_t currenttime;
 
   if (sess->logfd != -1) {
+    log_flush(sess);
     currenttime = time(NULL);
     write(sess->logfd, obuf,
           g_snprintf(obuf, sizeof(obuf) - 1, _("**** ENDING LOGGING AT %s\n"),
@@ -328,6 +503,12 @@ void log_close(session *sess) {
     close(sess->logfd);
     sess->logfd = -1;
   }
+
+  if (sess->logbuf) {
+    g_string_free(sess->logbuf, TRUE);
+    sess->logbuf = NULL;
+  }
+  g_clear_pointer(&sess->logpath, g_free);
 }
 
 /*
@@ -494,19 +675,12 @@ static char *log_create_pathname(char *servname, char *channame,
   return g_strdup(fname);
 }
 
-static int log_open_file(char *servname, char *channame, char *netname) {
+static int log_open_file(char *file) {
   char buf[512];
   int fd;
-  char *file;
   time_t currenttime;
 
-  file = log_create_pathname(servname, channame, netname);
-  if (!file)
-    return -1;
-
   fd = g_open(file, O_CREAT | O_APPEND | O_WRONLY | OFLAGS, 0644);
-  g_free(file);
-
   if (fd == -1)
     return -1;
   currenttime = time(NULL);
@@ -517,22 +691,32 @@ static int log_open_file(char *servname, char *channame, char *netname) {
   return fd;
 }
 
+/* the log path only depends on the time through the strftime part of the
+   logmask, so there's no need to look at it again until the next minute */
+
+static void log_set_check_time(session *sess, time_t now) {
+  sess->logcheck = now - (now % LOG_CHECK_INTERVAL) + LOG_CHECK_INTERVAL;
+}
+
 static void log_open(session *sess) {
   static gboolean log_error = FALSE;
+  char *file;
 
   log_close(sess);
-  sess->logfd = log_open_file(sess->server->servername, sess->channel,
-                              server_get_network(sess->server, FALSE));
+  file = log_create_pathname(sess->server->servername, sess->channel,
+                             server_get_network(sess->server, FALSE));
+  sess->logfd = log_open_file(file);
+  log_set_check_time(sess, time(NULL));
+
+  if (sess->logfd != -1) {
+    sess->logpath = file;
+    return;
+  }
 
-  if (!log_error && sess->logfd == -1) {
-    char *filename =
-        log_create_pathname(sess->server->servername, sess->channel,
-                            server_get_network(sess->server, FALSE));
+  if (!log_error) {
     char *message = g_strdup_printf(
         _("* Can't open log file(s) for writing. Check the\npermissions on %s"),
-        filename);
-
-    g_free(filename);
+        file);
 
     fe_message(message, FE_MSG_WAIT | FE_MSG_ERROR);
 
@@ -540,6 +724,36 @@ static void log_open(session *sess) {
 
     log_error = TRUE;
   }
+
+  g_free(file);
+}
+
+/* change to a different log file if the date in the path changed, or the
+   old one was moved away (e.g. by logrotate) */
+
+static void log_check_file(session *sess, time_t now) {
+  char *file;
+
+  log_set_check_time(sess, now);
+
+  file = log_create_pathname(sess->server->servername, sess->channel,
+                             server_get_network(sess->server, FALSE));
+
+  if (g_strcmp0(file, sess->logpath) == 0 && g_access(file, F_OK) == 0) {
+    g_free(file);
+    return;
+  }
+
+  log_flush(sess);
+  close(sess->logfd);
+  sess->logfd = log_open_file(file);
+
+  g_free(sess->logpath);
+  sess->logpath = NULL;
+  if (sess->logfd != -1)
+    sess->logpath = file;
+  else
+    g_free(file);
 }
 
 void log_open_or_close(session *sess) {
@@ -583,7 +797,7 @@ int get_stamp_str(char *fmt, time_t tim, char **ret) {
 static void log_write(session *sess, char *text, time_t ts) {
   char *temp;
   char *stamp;
-  char *file;
+  time_t now;
   int len;
 
   if (sess->text_logging == SET_DEFAULT) {
@@ -594,25 +808,11 @@ static void log_write(session *sess, char *text, time_t ts) {
       return;
   }
 
-  if (sess->logfd == -1) {
+  now = time(NULL);
+  if (sess->logfd == -1)
     log_open(sess);
-  }
-
-  /* change to a different log file? */
-  file = log_create_pathname(sess->server->servername, sess->channel,
-                             server_get_network(sess->server, FALSE));
-  if (file) {
-    if (g_access(file, F_OK) != 0) {
-      if (sess->logfd != -1) {
-        close(sess->logfd);
-      }
-
-      sess->logfd = log_open_file(sess->server->servername, sess->channel,
-                                  server_get_network(sess->server, FALSE));
-    }
-
-    g_free(file);
-  }
+  else if (now >= sess->logcheck)
+    log_check_file(sess, now);
 
   if (sess->logfd == -1) {
     return;
@@ -620,20 +820,20 @@ static void log_write(session *sess, char *text, time_t ts) {
 
   if (prefs.hex_stamp_log) {
     if (!ts)
-      ts = time(0);
+      ts = now;
     len = get_stamp_str(prefs.hex_stamp_log_format, ts, &stamp);
     if (len) {
-      write(sess->logfd, stamp, len);
+      log_append(sess, stamp, len);
       g_free(stamp);
     }
   }
 
   temp = strip_color(text, -1, STRIP_ALL);
   len = strlen(temp);
-  write(sess->logfd, temp, len);
+  log_append(sess, temp, len);
   /* lots of scripts/plugins print without a \n at the end */
   if (temp[len - 1] != '\n')
-    write(sess->logfd, "\n", 1); /* emulate what xtext would display */
+    log_append(sess, "\n", 1); /* emulate what xtext would display */
   g_free(temp);
 }
 
@@ -758,6 +958,13 @@ gchar *text_fixup_invalid_utf8(const gchar *text, gssize len, gsize *len_out) {
 #endif
 }
 
+/* text must be valid UTF-8, writable and not empty */
+static void print_text_utf8(session *sess, char *text, time_t timestamp) {
+  log_write(sess, text, timestamp);
+  scrollback_save(sess, text, timestamp);
+  fe_print_text(sess, text, timestamp, FALSE);
+}
+
 void PrintTextTimeStamp(session *sess, char *text, time_t timestamp) {
   if (!sess) {
     if (!sess_list)
@@ -772,9 +979,7 @@ void PrintTextTimeStamp(session *sess, char *text, time_t timestamp) {
     text = text_fixup_invalid_utf8(text, -1, NULL);
   }
 
-  log_write(sess, text, timestamp);
-  scrollback_save(sess, text, timestamp);
-  fe_print_text(sess, text, timestamp, FALSE);
+  print_text_utf8(sess, text, timestamp);
   g_free(text);
 }
 
@@ -963,6 +1168,17 @@ static char *const pevt_quit_help[] = {
     N_("Host"),
 };
 
+static char *const pevt_netsplit_help[] = {
+    N_("Servers"),
+    N_("Nicks"),
+    N_("Number of users"),
+};
+
+static char *const pevt_netjoin_help[] = {
+    N_("Nicks"),
+    N_("Number of users"),
+};
+
 static char *const pevt_pingrep_help[] = {
     N_("Who it's from"),
     N_("The time in x.x format (see below)"),
@@ -1590,10 +1806,30 @@ void load_text_events() {
 */
 #define ARG_FLAG(argn) (1 << (argn))
 
+/* Does text have any byte below 0x20? Those are all strip_color2() and
+   strip_hidden_attribute() look for, so arguments without any (most of
+   them) are copied as they are. Checks 8 bytes at a time. */
+static gboolean has_control_bytes(const char *text, gsize len) {
+  const guint64 ones = G_GUINT64_CONSTANT(0x0101010101010101);
+  guint64 w;
+  gsize i;
+
+  for (i = 0; i + sizeof(w) <= len; i += sizeof(w)) {
+    memcpy(&w, text + i, sizeof(w));
+    if ((w - ones * 0x20) & ~w & (ones * 0x80))
+      return TRUE;
+  }
+  for (; i < len; i++) {
+    if ((guchar)text[i] < 0x20)
+      return TRUE;
+  }
+  return FALSE;
+}
+
 void format_event(session *sess, int index, char **args, char *o, gsize sizeofo,
                   unsigned int stripcolor_args) {
   int len, ii, numargs;
-  gsize oi;
+  gsize oi, alen;
   char *i, *ar, d, a, done_all = FALSE;
 
   i = pntevts[index];
@@ -1632,10 +1868,16 @@ void format_event(session *sess, int index, char **args, char *o, gsize sizeofo,
       if (ar == NULL) {
         printf("arg[%d] is NULL in print event\n", a + 1);
       } else {
-        if (strlen(ar) > sizeofo - oi - 4)
-          ar[sizeofo - oi - 4] = 0; /* Avoid buffer overflow */
-        if (stripcolor_args & ARG_FLAG(a + 1))
-          len = strip_color2(ar, -1, &o[oi], STRIP_ALL);
+        alen = strlen(ar);
+        if (alen > sizeofo - oi - 4) {
+          alen = sizeofo - oi - 4;
+          ar[alen] = 0; /* Avoid buffer overflow */
+        }
+        if (!has_control_bytes(ar, alen)) {
+          memcpy(&o[oi], ar, alen);
+          len = alen;
+        } else if (stripcolor_args & ARG_FLAG(a + 1))
+          len = strip_color2(ar, alen, &o[oi], STRIP_ALL);
         else
           len = strip_hidden_attribute(ar, &o[oi]);
         oi += len;
@@ -1663,7 +1905,13 @@ static void display_event(session *sess, int event, char **args,
                           unsigned int stripcolor_args, time_t timestamp) {
   char o[4096];
   format_event(sess, event, args, o, sizeof(o), stripcolor_args);
-  if (o[0])
+  if (!o[0])
+    return;
+
+  /* Arguments are UTF-8 already, so this rarely needs a fixed up copy */
+  if (g_utf8_validate(o, -1, NULL))
+    print_text_utf8(sess, o, timestamp);
+  else
     PrintTextTimeStamp(sess, o, timestamp);
 }
 
@@ -1860,6 +2108,30 @@ int text_color_of(char *name) {
   return rcolors[sum];
 }
 
+/* Would this event be thrown away unseen in sess? Plugins still get
+   events that aren't printed, so it's only hidden if none hook it. */
+gboolean text_emit_hidden(int index, session *sess) {
+  switch (index) {
+  case XP_TE_JOIN:
+  case XP_TE_PART:
+  case XP_TE_PARTREASON:
+  case XP_TE_QUIT:
+  case XP_TE_NETJOIN:
+  case XP_TE_NETSPLIT:
+    if (!chanopt_is_set(prefs.hex_irc_conf_mode, sess->text_hidejoinpart))
+      return FALSE;
+    break;
+  case XP_TE_CHANGENICK:
+    if (!prefs.hex_irc_hide_nickchange)
+      return FALSE;
+    break;
+  default:
+    return FALSE;
+  }
+
+  return !plugin_print_hooked(te[index].name);
+}
+
 /* called by EMIT_SIGNAL macro */
 
 void text_emit(int index, session *sess, char *a, char *b, char *c, char *d,
@@ -1868,11 +2140,16 @@ void text_emit(int index, session *sess, char *a, char *b, char *c, char *d,
   int i;
   tab_state_flags current_state = sess->tab_state;
   tab_state_flags plugin_state = sess->last_tab_state;
-  unsigned int stripcolor_args =
+  unsigned int stripcolor_args;
+  char tbuf[NICKLEN + 4];
+
+  if (text_emit_hidden(index, sess))
+    return;
+
+  stripcolor_args =
       (chanopt_is_set(prefs.hex_text_stripcolor_msg, sess->text_strip)
            ? 0xFFFFFFFF
            : 0);
-  char tbuf[NICKLEN + 4];
 
   if (a != NULL && prefs.hex_text_color_nicks &&
       (index == XP_TE_CHANACTION || index == XP_TE_CHANMSG)) {
@@ -1910,6 +2187,8 @@ void text_emit(int index, session *sess, char *a, char *b, char *c, char *d,
   case XP_TE_PART:
   case XP_TE_PARTREASON:
   case XP_TE_QUIT:
+  case XP_TE_NETJOIN:
+  case XP_TE_NETSPLIT:
     /* implement ConfMode / Hide Join and Part Messages */
     if (chanopt_is_set(prefs.hex_irc_conf_mode, sess->text_hidejoinpart))
       return;
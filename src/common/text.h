@@ -46,6 +46,8 @@ void PrintTextTimeStamp (session *sess, char *text, time_t timestamp);
 void PrintTextf (session *sess, const char *format, ...) G_GNUC_PRINTF (2, 3);
 void PrintTextTimeStampf (session *sess, time_t timestamp, const char *format, ...) G_GNUC_PRINTF (3, 4);
 void log_close (session *sess);
+void log_append (session *sess, const char *text, gssize len);
+void log_flush_all (void);
 void log_open_or_close (session *sess);
 void load_text_events (void);
 void pevent_save (char *fn);
@@ -53,6 +55,7 @@ int pevt_build_string (const char *input, char **output, int *max_arg);
 int pevent_load (char *filename);
 void pevent_make_pntevts (void);
 int text_color_of (char *name);
+gboolean text_emit_hidden (int index, session *sess);
 void text_emit (int index, session *sess, char *a, char *b, char *c, char *d,
 		time_t timestamp);
 int text_emit_by_name (char *name, session *sess, time_t timestamp,
@@ -96,6 +96,8 @@ enum
 	XP_TE_MSGSEND,
 	XP_TE_MOTD,
 	XP_TE_MOTDSKIP,
+	XP_TE_NETJOIN,
+	XP_TE_NETSPLIT,
 	XP_TE_NICKCLASH,
 	XP_TE_NICKERROR,
 	XP_TE_NICKFAIL,
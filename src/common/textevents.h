@@ -282,6 +282,12 @@ N_("%C19*%O$t%C19You have been killed by %C26$1%C (%C20$2%O)")},
 {"MOTD Skipped", pevt_generic_none_help, 0,
 N_("%C29*%O$t%C29MOTD Skipped%O")},
 
+{"Netjoin", pevt_netjoin_help, 2,
+N_("%C23*$tNetjoin: $1 ($2 users) have rejoined")},
+
+{"Netsplit", pevt_netsplit_help, 3,
+N_("%C24*$tNetsplit $1: $2 ($3 users) have quit")},
+
 {"Nick Clash", pevt_nickclash_help, 2,
 N_("%C23*%O$t%C28$1%C is already in use. Retrying with %C18$2%O...")},
 
@@ -216,7 +216,8 @@ tree_grow (tree *t)
 {
 	if (t->array_size < t->elements + 1)
 	{
-		int new_size = t->array_size + ARRAY_GROW;
+		/* double it, so a big channel's NAMES isn't a realloc every 32 nicks */
+		int new_size = MAX (t->array_size * 2, ARRAY_GROW);
 
 		t->array = realloc (t->array, sizeof (void *) * new_size);
 		t->array_size = new_size;
@@ -247,6 +248,21 @@ tree_append (tree *t, void *key)
 	tree_insert_at_pos (t, key, t->elements);
 }
 
+/* replace the contents with an array that is already sorted by t->cmp */
+
+void
+tree_load (tree *t, void **keys, int count)
+{
+	if (t->array_size < count)
+	{
+		t->array = realloc (t->array, sizeof (void *) * count);
+		t->array_size = count;
+	}
+
+	memcpy (t->array, keys, sizeof (void *) * count);
+	t->elements = count;
+}
+
 int tree_size (tree *t)
 {
 	return t->elements;
@@ -35,6 +35,7 @@ void *tree_remove_at_pos (tree *t, int pos);
 void tree_foreach (tree *t, tree_traverse_func *func, void *data);
 int tree_insert (tree *t, void *key);
 void tree_append (tree* t, void *key);
+void tree_load (tree *t, void **keys, int count);
 int tree_size (tree *t);
 
 #endif
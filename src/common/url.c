@@ -24,14 +24,20 @@
 #include "hexchatc.h"
 #include "cfgfiles.h"
 #include "fe.h"
-#include "tree.h"
 #include "url.h"
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
 
-void *url_tree = NULL;
-GTree *url_btree = NULL;
+/* grabbed URLs, oldest first, and a set of the same strings to spot repeats */
+GQueue url_queue = G_QUEUE_INIT;
+static GHashTable *url_set = NULL;
+
+#define URL_LOG_FLUSH_SIZE 4096		/* bytes of url.log kept in memory */
+#define URL_LOG_FLUSH_INTERVAL 5	/* seconds before they are written anyway */
+
+static GString *url_log_buf = NULL;
+static int url_log_tag = 0;
 static gboolean regex_match (const GRegex *re, const char *word,
 							 int *start, int *end);
 static const GRegex *re_url (void);
@@ -50,34 +56,38 @@ static gboolean match_host (const char *word, int *start, int *end);
 static gboolean match_host6 (const char *word, int *start, int *end);
 static gboolean match_path (const char *word, int *start, int *end);
 
-static int
-url_free (char *url, void *data)
+static guint
+url_hash (gconstpointer key)
 {
-	g_free (url);
-	return TRUE;
+	const char *p = key;
+	guint h = 5381;
+
+	for (; *p; p++)
+		h = (h << 5) + h + g_ascii_tolower (*p);
+
+	return h;
 }
 
-void
-url_clear (void)
+static gboolean
+url_equal (gconstpointer a, gconstpointer b)
 {
-	tree_foreach (url_tree, (tree_traverse_func *)url_free, NULL);
-	tree_destroy (url_tree);
-	url_tree = NULL;
-	g_tree_destroy (url_btree);
-	url_btree = NULL;
+	return g_ascii_strcasecmp (a, b) == 0;
 }
 
-static int
-url_save_cb (char *url, FILE *fd)
+void
+url_clear (void)
 {
-	fprintf (fd, "%s\n", url);
-	return TRUE;
+	/* the set only borrows the queue's strings */
+	g_clear_pointer (&url_set, g_hash_table_destroy);
+	g_queue_foreach (&url_queue, (GFunc)g_free, NULL);
+	g_queue_clear (&url_queue);
 }
 
 void
 url_save_tree (const char *fname, const char *mode, gboolean fullpath)
 {
 	FILE *fd;
+	GList *list;
 
 	if (fullpath)
 		fd = hexchat_fopen_file (fname, mode, XOF_FULLPATH);
@@ -86,37 +96,64 @@ url_save_tree (const char *fname, const char *mode, gboolean fullpath)
 	if (fd == NULL)
 		return;
 
-	tree_foreach (url_tree, (tree_traverse_func *)url_save_cb, fd);
+	for (list = url_queue.head; list; list = list->next)
+		fprintf (fd, "%s\n", (char *)list->data);
 	fclose (fd);
 }
 
-static void
-url_save_node (char* url)
+void
+url_log_flush (void)
 {
 	FILE *fd;
 
+	if (url_log_tag)
+	{
+		fe_timeout_remove (url_log_tag);
+		url_log_tag = 0;
+	}
+
+	if (!url_log_buf || !url_log_buf->len)
+		return;
+
 	/* open <config>/url.log in append mode */
 	fd = hexchat_fopen_file ("url.log", "a", 0);
-	if (fd == NULL)
+	if (fd != NULL)
 	{
-		return;
+		fwrite (url_log_buf->str, 1, url_log_buf->len, fd);
+		fclose (fd);
 	}
 
-	fprintf (fd, "%s\n", url);
-	fclose (fd);	
+	g_string_truncate (url_log_buf, 0);
 }
 
 static int
-url_find (char *urltext)
+url_log_timeout (gpointer unused)
 {
-	return (g_tree_lookup_extended (url_btree, urltext, NULL, NULL));
+	url_log_tag = 0;
+	url_log_flush ();
+	return 0;
+}
+
+static void
+url_save_node (char* url)
+{
+	if (!url_log_buf)
+		url_log_buf = g_string_sized_new (URL_LOG_FLUSH_SIZE);
+
+	g_string_append (url_log_buf, url);
+	g_string_append_c (url_log_buf, '\n');
+
+	if (url_log_buf->len >= URL_LOG_FLUSH_SIZE)
+		url_log_flush ();
+	else if (!url_log_tag)
+		url_log_tag = fe_timeout_add_seconds (URL_LOG_FLUSH_INTERVAL, url_log_timeout, NULL);
 }
 
 static void
 url_add (char *urltext, int len)
 {
 	char *data;
-	int size;
+	int limit;
 
 	/* we don't need any URLs if we have neither URL grabbing nor URL logging enabled */
 	if (!prefs.hex_url_grabber && !prefs.hex_url_logging)
@@ -149,37 +186,28 @@ url_add (char *urltext, int len)
 		return;
 	}
 
-	if (!url_tree)
-	{
-		url_tree = tree_new ((tree_cmp_func *)strcasecmp, NULL);
-		url_btree = g_tree_new ((GCompareFunc)strcasecmp);
-	}
+	if (!url_set)
+		url_set = g_hash_table_new (url_hash, url_equal);
 
-	if (url_find (data))
+	if (g_hash_table_contains (url_set, data))
 	{
 		g_free (data);
 		return;
 	}
 
-	size = tree_size (url_tree);
-	/* 0 is unlimited */
-	if (prefs.hex_url_grabber_limit > 0 && size >= prefs.hex_url_grabber_limit)
+	/* 0 is unlimited. Loop, the limit may have been lowered while
+	   HexChat is running */
+	limit = prefs.hex_url_grabber_limit;
+	while (limit > 0 && url_queue.length >= (guint)limit)
 	{
-		/* the loop is necessary to handle having the limit lowered while
-		   HexChat is running */
-		size -= prefs.hex_url_grabber_limit;
-		for(; size > 0; size--)
-		{
-			char *pos;
+		char *old = g_queue_pop_head (&url_queue);
 
-			pos = tree_remove_at_pos (url_tree, 0);
-			g_tree_remove (url_btree, pos);
-			g_free (pos);
-		}
+		g_hash_table_remove (url_set, old);
+		g_free (old);
 	}
 
-	tree_append (url_tree, data);
-	g_tree_insert (url_btree, data, GINT_TO_POINTER (tree_size (url_tree) - 1));
+	g_queue_push_tail (&url_queue, data);
+	g_hash_table_add (url_set, data);
 	fe_url_add (data);
 }
 
@@ -20,7 +20,7 @@
 #ifndef HEXCHAT_URL_H
 #define HEXCHAT_URL_H
 
-extern void *url_tree;
+extern GQueue url_queue;
 
 #define WORD_URL     1
 #define WORD_CHANNEL 2
@@ -34,6 +34,7 @@ extern void *url_tree;
 
 void url_clear (void);
 void url_save_tree (const char *fname, const char *mode, gboolean fullpath);
+void url_log_flush (void);
 int url_last (int *, int *);
 int url_check_word (const char *word);
 void url_check_line (char *buf);
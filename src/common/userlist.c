@@ -58,6 +58,103 @@ nick_cmp_alpha (struct User *user1, struct User *user2, server *serv)
 	return serv->p_cmp (user1->nick, user2->nick);
 }
 
+/* add a user to the nick hashes of its channel and server */
+
+static void
+userlist_index_add (session *sess, struct User *user)
+{
+	server *serv = sess->server;
+	GPtrArray *sessions;
+
+	if (!sess->userhash)
+		sess->userhash = casemap_hash_table_new (serv->p_cmp, NULL, NULL);
+	g_hash_table_insert (sess->userhash, user->nick, user);
+
+	if (!serv->user_sessions)
+		serv->user_sessions = casemap_hash_table_new (serv->p_cmp, g_free,
+																	 (GDestroyNotify) g_ptr_array_unref);
+
+	sessions = g_hash_table_lookup (serv->user_sessions, user->nick);
+	if (!sessions)
+	{
+		sessions = g_ptr_array_sized_new (1);
+		g_hash_table_insert (serv->user_sessions, g_strdup (user->nick), sessions);
+	}
+	g_ptr_array_add (sessions, sess);
+}
+
+static void
+userlist_index_remove (session *sess, struct User *user)
+{
+	server *serv = sess->server;
+	GPtrArray *sessions;
+
+	if (sess->userhash)
+		g_hash_table_remove (sess->userhash, user->nick);
+
+	if (!serv->user_sessions)
+		return;
+
+	sessions = g_hash_table_lookup (serv->user_sessions, user->nick);
+	if (sessions)
+	{
+		g_ptr_array_remove_fast (sessions, sess);
+		if (sessions->len == 0)
+			g_hash_table_remove (serv->user_sessions, user->nick);
+	}
+}
+
+static int
+reindex_cb (struct User *user, session *sess)
+{
+	userlist_index_add (sess, user);
+	return TRUE;
+}
+
+/* rebuild the nick hashes after serv->p_cmp changed */
+
+void
+userlist_reindex (server *serv)
+{
+	GSList *list;
+	session *sess;
+
+	g_clear_pointer (&serv->user_sessions, g_hash_table_destroy);
+
+	for (list = sess_list; list; list = list->next)
+	{
+		sess = list->data;
+		if (sess->server == serv && sess->userhash)
+		{
+			g_clear_pointer (&sess->userhash, g_hash_table_destroy);
+			tree_foreach (sess->usertree, (tree_traverse_func *)reindex_cb, sess);
+			if (sess->names_pending)
+				g_ptr_array_foreach (sess->names_pending, (GFunc)reindex_cb, sess);
+		}
+	}
+}
+
+/* the channels we share with a nick, free the list with g_slist_free() */
+
+GSList *
+userlist_find_sessions (server *serv, const char *nick)
+{
+	GPtrArray *sessions;
+	GSList *list = NULL;
+	guint i;
+
+	if (!serv->user_sessions)
+		return NULL;
+
+	sessions = g_hash_table_lookup (serv->user_sessions, nick);
+	if (sessions)
+	{
+		for (i = 0; i < sessions->len; i++)
+			list = g_slist_prepend (list, g_ptr_array_index (sessions, i));
+	}
+	return list;
+}
+
 /*
  insert name in appropriate place in linked list. Returns row number or:
   -1: duplicate
@@ -66,12 +163,28 @@ nick_cmp_alpha (struct User *user1, struct User *user2, server *serv)
 static int
 userlist_insertname (session *sess, struct User *newuser)
 {
+	int row;
+
 	if (!sess->usertree)
 	{
 		sess->usertree = tree_new ((tree_cmp_func *)nick_cmp_alpha, sess->server);
 	}
 
-	return tree_insert (sess->usertree, newuser);
+	row = tree_insert (sess->usertree, newuser);
+	if (row != -1)
+		userlist_index_add (sess, newuser);
+
+	return row;
+}
+
+/* anything that changes or walks the usertree has to see the queued users */
+
+void
+userlist_flush_pending (struct session *sess)
+{
+	message_tags_data no_tags = MESSAGE_TAGS_DATA_INIT;
+
+	userlist_flush_names (sess, &no_tags);
 }
 
 void
@@ -93,6 +206,17 @@ userlist_set_away (struct session *sess, char *nick, unsigned int away)
 	}
 }
 
+void
+userlist_set_away_global (server *serv, char *nick, unsigned int away)
+{
+	GSList *list, *sessions;
+
+	sessions = userlist_find_sessions (serv, nick);
+	for (list = sessions; list; list = list->next)
+		userlist_set_away (list->data, nick, away);
+	g_slist_free (sessions);
+}
+
 void
 userlist_set_account (struct session *sess, char *nick, char *account)
 {
@@ -115,6 +239,17 @@ userlist_set_account (struct session *sess, char *nick, char *account)
 	}
 }
 
+void
+userlist_set_account_global (server *serv, char *nick, char *account)
+{
+	GSList *list, *sessions;
+
+	sessions = userlist_find_sessions (serv, nick);
+	for (list = sessions; list; list = list->next)
+		userlist_set_account (list->data, nick, account);
+	g_slist_free (sessions);
+}
+
 int
 userlist_add_hostname (struct session *sess, char *nick, char *hostname,
 							  char *realname, char *servername, char *account, unsigned int away)
@@ -169,11 +304,26 @@ free_user (struct User *user, gpointer data)
 	return TRUE;
 }
 
+static int
+free_user_cb (struct User *user, session *sess)
+{
+	userlist_index_remove (sess, user);
+	return free_user (user, NULL);
+}
+
 void
 userlist_free (session *sess)
 {
-	tree_foreach (sess->usertree, (tree_traverse_func *)free_user, NULL);
+	if (sess->names_pending)
+	{
+		g_ptr_array_foreach (sess->names_pending, (GFunc)free_user_cb, sess);
+		g_ptr_array_free (sess->names_pending, TRUE);
+		sess->names_pending = NULL;
+	}
+
+	tree_foreach (sess->usertree, (tree_traverse_func *)free_user_cb, sess);
 	tree_destroy (sess->usertree);
+	g_clear_pointer (&sess->userhash, g_hash_table_destroy);
 
 	sess->usertree = NULL;
 	sess->me = NULL;
@@ -192,20 +342,11 @@ userlist_clear (session *sess)
 	fe_userlist_numbers (sess);
 }
 
-static int
-find_cmp (const char *name, struct User *user, server *serv)
-{
-	return serv->p_cmp ((char *)name, user->nick);
-}
-
 struct User *
 userlist_find (struct session *sess, const char *name)
 {
-	int pos;
-
-	if (sess->usertree)
-		return tree_find (sess->usertree, name,
-								(tree_cmp_func *)find_cmp, sess->server, &pos);
+	if (sess->userhash)
+		return g_hash_table_lookup (sess->userhash, name);
 
 	return NULL;
 }
@@ -213,20 +354,15 @@ userlist_find (struct session *sess, const char *name)
 struct User *
 userlist_find_global (struct server *serv, char *name)
 {
-	struct User *user;
-	session *sess;
-	GSList *list = sess_list;
-	while (list)
-	{
-		sess = (session *) list->data;
-		if (sess->server == serv)
-		{
-			user = userlist_find (sess, name);
-			if (user)
-				return user;
-		}
-		list = list->next;
-	}
+	GPtrArray *sessions;
+
+	if (!serv->user_sessions)
+		return NULL;
+
+	sessions = g_hash_table_lookup (serv->user_sessions, name);
+	if (sessions && sessions->len)
+		return userlist_find (g_ptr_array_index (sessions, 0), name);
+
 	return NULL;
 }
 
@@ -265,6 +401,8 @@ userlist_update_mode (session *sess, char *name, char mode, char sign)
 	if (!user)
 		return;
 
+	userlist_flush_pending (sess);
+
 	/* remove from binary trees, before we loose track of it */
 	tree_remove (sess->usertree, user, &pos);
 	fe_userlist_remove (sess, user);
@@ -310,12 +448,15 @@ userlist_change (struct session *sess, char *oldname, char *newname)
 
 	if (user)
 	{
+		userlist_flush_pending (sess);
 		tree_remove (sess->usertree, user, &pos);
+		userlist_index_remove (sess, user);
 		fe_userlist_remove (sess, user);
 
 		safe_strcpy (user->nick, newname, NICKLEN);
 
-		tree_insert (sess->usertree, user);
+		if (tree_insert (sess->usertree, user) != -1)
+			userlist_index_add (sess, user);
 		fe_userlist_insert (sess, user, FALSE);
 
 		return 1;
@@ -341,6 +482,9 @@ void
 userlist_remove_user (struct session *sess, struct User *user)
 {
 	int pos;
+
+	userlist_flush_pending (sess);
+
 	if (user->voice)
 		sess->voices--;
 	if (user->op)
@@ -355,33 +499,30 @@ userlist_remove_user (struct session *sess, struct User *user)
 		sess->me = NULL;
 
 	tree_remove (sess->usertree, user, &pos);
+	userlist_index_remove (sess, user);
 	free_user (user, NULL);
 }
 
-void
-userlist_add (struct session *sess, char *name, char *hostname,
-				  char *account, char *realname, const message_tags_data *tags_data)
+/* make a User from a nick with its mode prefixes, e.g. "@nick" */
+
+static struct User *
+userlist_new_user (session *sess, char *name, char *hostname,
+						 char *account, char *realname, int *prefix_chars)
 {
 	struct User *user;
-	int row, prefix_chars;
-	unsigned int acc;
-
-	acc = nick_access (sess->server, name, &prefix_chars);
-
-	notify_set_online (sess->server, name + prefix_chars, tags_data);
 
 	user = g_new0 (struct User, 1);
 
-	user->access = acc;
+	user->access = nick_access (sess->server, name, prefix_chars);
 
 	/* assume first char is the highest level nick prefix */
-	if (prefix_chars)
+	if (*prefix_chars)
 		user->prefix[0] = name[0];
 
 	/* add it to our linked list */
 	if (hostname)
 		user->hostname = g_strdup (hostname);
-	safe_strcpy (user->nick, name + prefix_chars, NICKLEN);
+	safe_strcpy (user->nick, name + *prefix_chars, NICKLEN);
 	/* is it me? */
 	if (!sess->server->p_cmp (user->nick, sess->server->nick))
 		user->me = TRUE;
@@ -394,18 +535,14 @@ userlist_add (struct session *sess, char *name, char *hostname,
 			user->realname = g_strdup (realname);
 	}
 
-	row = userlist_insertname (sess, user);
+	return user;
+}
 
-	/* duplicate? some broken servers trigger this */
-	if (row == -1)
-	{
-		g_free (user->hostname);
-		g_free (user->account);
-		g_free (user->realname);
-		g_free (user);
-		return;
-	}
+/* count a newly added user in the channel totals */
 
+static void
+userlist_count_user (session *sess, struct User *user, char *name, int prefix_chars)
+{
 	sess->total++;
 
 	/* most ircds don't support multiple modechars in front of the nickname
@@ -419,12 +556,103 @@ userlist_add (struct session *sess, char *name, char *hostname,
 
 	if (user->me)
 		sess->me = user;
+}
+
+void
+userlist_add (struct session *sess, char *name, char *hostname,
+				  char *account, char *realname, const message_tags_data *tags_data)
+{
+	struct User *user;
+	int row, prefix_chars;
+
+	userlist_flush_names (sess, tags_data);
+
+	user = userlist_new_user (sess, name, hostname, account, realname, &prefix_chars);
+
+	notify_set_online (sess->server, user->nick, tags_data);
+
+	row = userlist_insertname (sess, user);
+
+	/* duplicate? some broken servers trigger this */
+	if (row == -1)
+	{
+		free_user (user, NULL);
+		return;
+	}
+
+	userlist_count_user (sess, user, name, prefix_chars);
 
 	fe_userlist_insert (sess, user, FALSE);
 	if(sess->end_of_names)
 		fe_userlist_numbers (sess);
 }
 
+/* Queue a user from a NAMES reply. They can be found with userlist_find()
+   right away, but go into the usertree and the GUI in one go when
+   userlist_flush_names() is called at the end of the reply. */
+
+void
+userlist_add_names (struct session *sess, char *name, char *hostname)
+{
+	struct User *user;
+	int prefix_chars;
+
+	user = userlist_new_user (sess, name, hostname, NULL, NULL, &prefix_chars);
+
+	/* duplicate? some broken servers trigger this */
+	if (userlist_find (sess, user->nick))
+	{
+		free_user (user, NULL);
+		return;
+	}
+
+	userlist_index_add (sess, user);
+	userlist_count_user (sess, user, name, prefix_chars);
+
+	if (!sess->names_pending)
+		sess->names_pending = g_ptr_array_new ();
+	g_ptr_array_add (sess->names_pending, user);
+}
+
+static int
+names_cmp (gconstpointer a, gconstpointer b, gpointer serv)
+{
+	return nick_cmp_alpha (*(struct User **)a, *(struct User **)b, serv);
+}
+
+void
+userlist_flush_names (struct session *sess, const message_tags_data *tags_data)
+{
+	GPtrArray *pending = sess->names_pending;
+	guint i;
+
+	if (!pending)
+		return;
+	sess->names_pending = NULL;
+
+	if (!sess->usertree)
+	{
+		sess->usertree = tree_new ((tree_cmp_func *)nick_cmp_alpha, sess->server);
+	}
+
+	if (tree_size (sess->usertree) == 0)
+	{
+		/* the usual case after a JOIN, sort once instead of inserting each */
+		g_ptr_array_sort_with_data (pending, names_cmp, sess->server);
+		tree_load (sess->usertree, pending->pdata, pending->len);
+	}
+	else
+	{
+		for (i = 0; i < pending->len; i++)
+			tree_insert (sess->usertree, g_ptr_array_index (pending, i));
+	}
+
+	fe_userlist_insert_list (sess, pending);
+	notify_set_online_users (sess->server, sess, tags_data);
+
+	g_ptr_array_free (pending, TRUE);
+}
+
 static int
 rehash_cb (struct User *user, session *sess)
 {
@@ -435,6 +663,7 @@ rehash_cb (struct User *user, session *sess)
 void
 userlist_rehash (session *sess)
 {
+	userlist_flush_pending (sess);
 	tree_foreach (sess->usertree, (tree_traverse_func *)rehash_cb, sess);
 }
 
@@ -450,6 +679,7 @@ userlist_flat_list (session *sess)
 {
 	GSList *list = NULL;
 
+	userlist_flush_pending (sess);
 	tree_foreach (sess->usertree, (tree_traverse_func *)flat_cb, &list);
 	return g_slist_reverse (list);
 }
@@ -466,6 +696,7 @@ userlist_double_list(session *sess)
 {
 	GList *list = NULL;
 
+	userlist_flush_pending (sess);
 	tree_foreach (sess->usertree, (tree_traverse_func *)double_cb, &list);
 	return list;
 }
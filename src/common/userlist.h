@@ -47,13 +47,20 @@ int userlist_add_hostname (session *sess, char *nick,
 									char *hostname, char *realname,
 									char *servername, char *account, unsigned int away);
 void userlist_set_away (session *sess, char *nick, unsigned int away);
+void userlist_set_away_global (server *serv, char *nick, unsigned int away);
 void userlist_set_account (session *sess, char *nick, char *account);
+void userlist_set_account_global (server *serv, char *nick, char *account);
 struct User *userlist_find (session *sess, const char *name);
 struct User *userlist_find_global (server *serv, char *name);
+GSList *userlist_find_sessions (server *serv, const char *nick);
+void userlist_reindex (server *serv);
 void userlist_clear (session *sess);
 void userlist_free (session *sess);
 void userlist_add (session *sess, char *name, char *hostname, char *account,
 						 char *realname, const message_tags_data *tags_data);
+void userlist_add_names (session *sess, char *name, char *hostname);
+void userlist_flush_names (session *sess, const message_tags_data *tags_data);
+void userlist_flush_pending (session *sess);
 int userlist_remove (session *sess, char *name);
 void userlist_remove_user (session *sess, struct User *user);
 int userlist_change (session *sess, char *oldname, char *newname);
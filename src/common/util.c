@@ -1036,6 +1036,50 @@ rfc_casecmp (const char *s1, const char *s2)
 	return (((int)*s1) - ((int)*s2));
 }
 
+/* A hash that agrees with both rfc_casecmp() and g_ascii_strcasecmp(), for
+   tables keyed by nick or channel name. */
+
+guint
+rfc_str_hash (gconstpointer key)
+{
+	const unsigned char *p = key;
+	guint h = 5381;
+
+	while (*p)
+	{
+		h = (h << 5) + h + rfc_tolower (*p);
+		p++;
+	}
+	return h;
+}
+
+static gboolean
+rfc_str_equal (gconstpointer a, gconstpointer b)
+{
+	return rfc_casecmp (a, b) == 0;
+}
+
+static gboolean
+ascii_str_equal (gconstpointer a, gconstpointer b)
+{
+	return g_ascii_strcasecmp (a, b) == 0;
+}
+
+/* A hash table whose keys compare like cmp, which is a server's p_cmp. It
+   needs to be rebuilt if that changes (CASEMAPPING in 005). */
+
+GHashTable *
+casemap_hash_table_new (int (*cmp) (const char *, const char *),
+								GDestroyNotify key_destroy, GDestroyNotify value_destroy)
+{
+	if (cmp == (void *)g_ascii_strcasecmp)
+		return g_hash_table_new_full (rfc_str_hash, ascii_str_equal,
+												key_destroy, value_destroy);
+
+	return g_hash_table_new_full (rfc_str_hash, rfc_str_equal,
+											key_destroy, value_destroy);
+}
+
 int
 rfc_ncasecmp (char *s1, char *s2, int n)
 {
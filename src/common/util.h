@@ -46,6 +46,9 @@ char *file_part (char *file);
 void for_files (const char *dirname, const char *mask, void callback (char *file));
 int rfc_casecmp (const char *, const char *);
 int rfc_ncasecmp (char *, char *, int);
+guint rfc_str_hash (gconstpointer key);
+GHashTable *casemap_hash_table_new (int (*cmp) (const char *, const char *),
+											  GDestroyNotify key_destroy, GDestroyNotify value_destroy);
 int buf_get_line (char *, char **, int *, int len);
 char *nocasestrstr (const char *text, const char *tofind);
 char *country (char *);
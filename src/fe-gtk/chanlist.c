@@ -56,34 +56,195 @@ enum
 #ifndef CUSTOM_LIST
 typedef struct	/* this is now in custom-list.h */
 {
-	char *topic;
+	const char *chan;
+	const char *topic;
 	char *collation_key;
 	guint32	pos;
 	guint32 users;
-	/* channel string lives beyond "users" */
-#define GET_CHAN(row) (((char *)row)+sizeof(chanlistrow))
 }
 chanlistrow;
 #endif
 
 #define GET_MODEL(xserv) (gtk_tree_view_get_model(GTK_TREE_VIEW(xserv->gui->chanlist_list)))
 
+/* rows are allocated this many at a time, so they never move */
+#define CHANLIST_BLOCK_ROWS 1024
+#define CHANLIST_ROW(blocks, n) \
+	(&((chanlistrow *) (blocks)[(n) / CHANLIST_BLOCK_ROWS])[(n) % CHANLIST_BLOCK_ROWS])
+
+/* the filter thread hands matches over this many at a time */
+#define CHANLIST_CHUNK_ROWS 2000
+
+/* Every row of the last LIST reply. Channel names and topics are packed into
+ * one string chunk rather than allocated row by row. A filter thread holds a
+ * reference while it reads the rows. */
+struct chanlist_store
+{
+	gint refs;
+	GStringChunk *strings;
+	GPtrArray *blocks;	/* of CHANLIST_BLOCK_ROWS rows each */
+	guint count;
+	guint users;
+};
+
+/* what the window is set to look for */
+struct chanlist_criteria
+{
+	int search_type;
+	const char *pattern;
+	GRegex *regex;
+	gboolean wants_channel;
+	gboolean wants_topic;
+	guint32 minusers;
+	guint32 maxusers;
+};
+
+/* A refilter of the stored rows, run in a thread so a big list doesn't freeze
+ * the window. Matches come back through a queue which chanlist_timeout()
+ * drains; the last chunk holds all of them, sorted. */
+struct chanlist_filter
+{
+	gint refs;
+	gint cancelled;
+	struct chanlist_store *store;
+	gpointer *blocks;			/* the store's blocks as they were when we started */
+	guint count;
+	chanlistrow **rows;		/* if set, these are already filtered and only need sorting */
+	struct chanlist_criteria criteria;
+	gint sort_id;
+	GtkSortType sort_order;
+	GAsyncQueue *results;
+};
+
+struct chanlist_chunk
+{
+	chanlistrow **rows;
+	guint count;
+	gboolean sorted;
+};
+
+
+static struct chanlist_store *
+chanlist_store_new (void)
+{
+	struct chanlist_store *store = g_new0 (struct chanlist_store, 1);
+
+	store->refs = 1;
+	store->strings = g_string_chunk_new (64 * 1024);
+	store->blocks = g_ptr_array_new ();
+
+	return store;
+}
+
+static struct chanlist_store *
+chanlist_store_ref (struct chanlist_store *store)
+{
+	g_atomic_int_inc (&store->refs);
+	return store;
+}
+
+static void
+chanlist_store_unref (struct chanlist_store *store)
+{
+	guint i;
+
+	if (!g_atomic_int_dec_and_test (&store->refs))
+		return;
+
+	for (i = 0; i < store->count; i++)
+		g_free (CHANLIST_ROW (store->blocks->pdata, i)->collation_key);
+
+	for (i = 0; i < store->blocks->len; i++)
+		g_free (store->blocks->pdata[i]);
+
+	g_ptr_array_free (store->blocks, TRUE);
+	g_string_chunk_free (store->strings);
+	g_free (store);
+}
+
+static chanlistrow *
+chanlist_store_add (struct chanlist_store *store, const char *chan, guint32 users,
+						  const char *topic)
+{
+	chanlistrow *row;
+	char *stripped;
+
+	if (store->count % CHANLIST_BLOCK_ROWS == 0)
+		g_ptr_array_add (store->blocks, g_new (chanlistrow, CHANLIST_BLOCK_ROWS));
+
+	row = CHANLIST_ROW (store->blocks->pdata, store->count);
+	row->chan = g_string_chunk_insert (store->strings, chan);
+	/* stripping only ever shortens the topic, so it can be done in place */
+	stripped = g_string_chunk_insert (store->strings, topic);
+	strip_color2 (stripped, -1, stripped, STRIP_ALL);
+	row->topic = stripped;
+	row->collation_key = NULL;
+	row->pos = 0;
+	row->users = users;
+
+	store->count++;
+	store->users += users;
+
+	return row;
+}
 
 static gboolean
-chanlist_match (server *serv, const char *str)
+chanlist_match (const struct chanlist_criteria *crit, const char *str)
 {
-	switch (serv->gui->chanlist_search_type)
+	switch (crit->search_type)
 	{
 	case 1:
-		return match (gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild)), str);
+		return match (crit->pattern, str);
 	case 2:
-		if (!serv->gui->have_regex)
+		if (!crit->regex)
 			return 0;
 
-		return g_regex_match (serv->gui->chanlist_match_regex, str, 0, NULL);
+		return g_regex_match (crit->regex, str, 0, NULL);
 	default:	/* case 0: */
-		return nocasestrstr (str, gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild))) ? 1 : 0;
+		return nocasestrstr (str, crit->pattern) ? 1 : 0;
+	}
+}
+
+/* this is also called from the filter thread, so no widgets in here */
+
+static gboolean
+chanlist_row_matches (const struct chanlist_criteria *crit, chanlistrow *row)
+{
+	if (row->users < crit->minusers)
+		return FALSE;
+
+	if (row->users > crit->maxusers && crit->maxusers > 0)
+		return FALSE;
+
+	if (crit->pattern[0])
+	{
+		/* Check what the user wants to match. If both buttons or _neither_
+		 * button is checked, look for match in both by default. 
+		 */
+		if (crit->wants_channel == crit->wants_topic)
+			return chanlist_match (crit, row->chan) || chanlist_match (crit, row->topic);
+
+		if (crit->wants_channel)
+			return chanlist_match (crit, row->chan);
+
+		return chanlist_match (crit, row->topic);
 	}
+
+	return TRUE;
+}
+
+/* the strings and regex are borrowed from the window */
+
+static void
+chanlist_get_criteria (server *serv, struct chanlist_criteria *crit)
+{
+	crit->search_type = serv->gui->chanlist_search_type;
+	crit->pattern = gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild));
+	crit->regex = serv->gui->have_regex ? serv->gui->chanlist_match_regex : NULL;
+	crit->wants_channel = serv->gui->chanlist_match_wants_channel;
+	crit->wants_topic = serv->gui->chanlist_match_wants_topic;
+	crit->minusers = serv->gui->chanlist_minusers;
+	crit->maxusers = serv->gui->chanlist_maxusers;
 }
 
 /**
@@ -132,27 +293,220 @@ chanlist_reset_counters (server *serv)
 	chanlist_update_buttons (serv);
 }
 
-/* free up our entire linked list and all the nodes */
+static void
+chanlist_chunk_free (struct chanlist_chunk *chunk)
+{
+	g_free (chunk->rows);
+	g_free (chunk);
+}
 
 static void
-chanlist_data_free (server *serv)
+chanlist_filter_unref (struct chanlist_filter *filter)
+{
+	if (!g_atomic_int_dec_and_test (&filter->refs))
+		return;
+
+	g_async_queue_unref (filter->results);
+	if (filter->criteria.regex)
+		g_regex_unref (filter->criteria.regex);
+	g_free ((char *) filter->criteria.pattern);
+	g_free (filter->blocks);
+	g_free (filter->rows);
+	chanlist_store_unref (filter->store);
+	g_free (filter);
+}
+
+/* takes ownership of rows */
+
+static void
+chanlist_filter_push (struct chanlist_filter *filter, chanlistrow **rows,
+							 guint count, gboolean sorted)
+{
+	struct chanlist_chunk *chunk = g_new (struct chanlist_chunk, 1);
+
+	chunk->rows = rows;
+	chunk->count = count;
+	chunk->sorted = sorted;
+	g_async_queue_push (filter->results, chunk);
+}
+
+static chanlistrow **
+chanlist_rows_dup (gpointer *rows, guint count)
+{
+	chanlistrow **copy = g_new (chanlistrow *, count);
+
+	memcpy (copy, rows, count * sizeof (chanlistrow *));
+	return copy;
+}
+
+static gint
+chanlist_filter_compare (gconstpointer a, gconstpointer b, gpointer data)
+{
+	struct chanlist_filter *filter = data;
+
+	return custom_list_compare_rows (*(chanlistrow **) a, *(chanlistrow **) b,
+												filter->sort_id, filter->sort_order);
+}
+
+static gpointer
+chanlist_filter_thread (gpointer data)
+{
+	struct chanlist_filter *filter = data;
+	GPtrArray *matches;
+	chanlistrow **rows;
+	chanlistrow *row;
+	guint i, count, sent = 0;
+
+	if (filter->rows)
+	{
+		rows = filter->rows;
+		count = filter->count;
+		filter->rows = NULL;
+	}
+	else
+	{
+		matches = g_ptr_array_new ();
+
+		for (i = 0; i < filter->count; i++)
+		{
+			if (i % CHANLIST_CHUNK_ROWS == 0 && g_atomic_int_get (&filter->cancelled))
+				break;
+
+			row = CHANLIST_ROW (filter->blocks, i);
+			if (!chanlist_row_matches (&filter->criteria, row))
+				continue;
+
+			g_ptr_array_add (matches, row);
+			if (matches->len - sent == CHANLIST_CHUNK_ROWS)
+			{
+				chanlist_filter_push (filter, chanlist_rows_dup (matches->pdata + sent,
+											 CHANLIST_CHUNK_ROWS), CHANLIST_CHUNK_ROWS, FALSE);
+				sent = matches->len;
+			}
+		}
+
+		if (matches->len > sent)
+			chanlist_filter_push (filter, chanlist_rows_dup (matches->pdata + sent,
+										 matches->len - sent), matches->len - sent, FALSE);
+
+		count = matches->len;
+		rows = (chanlistrow **) g_ptr_array_free (matches, FALSE);
+	}
+
+	if (!g_atomic_int_get (&filter->cancelled))
+	{
+		g_qsort_with_data (rows, count, sizeof (chanlistrow *),
+								 chanlist_filter_compare, filter);
+		chanlist_filter_push (filter, rows, count, TRUE);
+	}
+	else
+		g_free (rows);
+
+	chanlist_filter_unref (filter);
+	return NULL;
+}
+
+/**
+ * Starts a thread to filter and sort the stored rows into the list, or, if
+ * rows is given, only to sort those.
+ */
+static void
+chanlist_filter_start (server *serv, chanlistrow **rows, guint count)
+{
+	struct chanlist_store *store = serv->gui->chanlist_store;
+	CustomList *model = (CustomList *) GET_MODEL (serv);
+	struct chanlist_filter *filter;
+
+	filter = g_new0 (struct chanlist_filter, 1);
+	filter->refs = 2;	/* ours and the thread's */
+	filter->store = chanlist_store_ref (store);
+
+	if (rows)
+	{
+		filter->rows = rows;
+		filter->count = count;
+	}
+	else
+	{
+		filter->blocks = (gpointer *) chanlist_rows_dup (store->blocks->pdata, store->blocks->len);
+		filter->count = store->count;
+	}
+
+	chanlist_get_criteria (serv, &filter->criteria);
+	filter->criteria.pattern = g_strdup (filter->criteria.pattern);
+	if (filter->criteria.regex)
+		g_regex_ref (filter->criteria.regex);
+
+	filter->sort_id = model->sort_id;
+	filter->sort_order = model->sort_order;
+	filter->results = g_async_queue_new_full ((GDestroyNotify) chanlist_chunk_free);
+
+	serv->gui->chanlist_filter = filter;
+	g_thread_unref (g_thread_new ("chanlist", chanlist_filter_thread, filter));
+}
+
+/* The thread notices when it next looks and drops what it was doing */
+
+static void
+chanlist_filter_stop (server *serv)
 {
-	GSList *rows;
-	chanlistrow *data;
+	if (serv->gui->chanlist_filter)
+	{
+		g_atomic_int_set (&serv->gui->chanlist_filter->cancelled, TRUE);
+		chanlist_filter_unref (serv->gui->chanlist_filter);
+		serv->gui->chanlist_filter = NULL;
+	}
+}
 
-	if (serv->gui->chanlist_data_stored_rows)
+/* add whatever the filter thread has matched since the last update */
+
+static void
+chanlist_flush_filter (server *serv)
+{
+	struct chanlist_filter *filter = serv->gui->chanlist_filter;
+	CustomList *model = (CustomList *) GET_MODEL (serv);
+	struct chanlist_chunk *chunk;
+	guint i;
+
+	while ((chunk = g_async_queue_try_pop (filter->results)))
 	{
-		for (rows = serv->gui->chanlist_data_stored_rows; rows != NULL;
-			  rows = rows->next)
+		if (chunk->sorted)
 		{
-			data = rows->data;
-			g_free (data->topic);
-			g_free (data->collation_key);
-			g_free (data);
+			/* if the list was resorted or got new rows meanwhile, this order is stale */
+			if (model->sort_id != filter->sort_id || model->sort_order != filter->sort_order
+				 || !custom_list_reorder (model, chunk->rows, chunk->count))
+				custom_list_resort (model);
+
+			chanlist_chunk_free (chunk);
+			chanlist_filter_stop (serv);
+			break;
 		}
 
-		g_slist_free (serv->gui->chanlist_data_stored_rows);
-		serv->gui->chanlist_data_stored_rows = NULL;
+		for (i = 0; i < chunk->count; i++)
+		{
+			custom_list_append (model, chunk->rows[i]);
+			serv->gui->chanlist_users_shown_count += chunk->rows[i]->users;
+		}
+		serv->gui->chanlist_channels_shown_count += chunk->count;
+		serv->gui->chanlist_caption_is_stale = TRUE;
+
+		chanlist_chunk_free (chunk);
+	}
+
+	chanlist_update_buttons (serv);
+}
+
+/* drop the stored rows, and stop any filter that is reading them */
+
+static void
+chanlist_data_free (server *serv)
+{
+	chanlist_filter_stop (serv);
+
+	if (serv->gui->chanlist_store)
+	{
+		chanlist_store_unref (serv->gui->chanlist_store);
+		serv->gui->chanlist_store = NULL;
 	}
 
 	g_slist_free (serv->gui->chanlist_pending_rows);
@@ -164,10 +518,14 @@ chanlist_data_free (server *serv)
 static void
 chanlist_flush_pending (server *serv)
 {
-	GSList *list = serv->gui->chanlist_pending_rows;
+	GSList *list;
 	GtkTreeModel *model;
 	chanlistrow *row;
 
+	if (serv->gui->chanlist_filter)
+		chanlist_flush_filter (serv);
+
+	list = serv->gui->chanlist_pending_rows;
 	if (!list)
 	{
 		if (serv->gui->chanlist_caption_is_stale)
@@ -200,8 +558,9 @@ chanlist_timeout (server *serv)
  * the user and regex/search requirements.
  */
 static void
-chanlist_place_row_in_gui (server *serv, chanlistrow *next_row, gboolean force)
+chanlist_place_row_in_gui (server *serv, chanlistrow *next_row)
 {
+	struct chanlist_criteria crit;
 	GtkTreeModel *model;
 
 	/* First, update the 'found' counter values */
@@ -212,55 +571,14 @@ chanlist_place_row_in_gui (server *serv, chanlistrow *next_row, gboolean force)
 		/* join & save buttons become live */
 		chanlist_update_buttons (serv);
 
-	if (next_row->users < serv->gui->chanlist_minusers)
+	chanlist_get_criteria (serv, &crit);
+	if (!chanlist_row_matches (&crit, next_row))
 	{
 		serv->gui->chanlist_caption_is_stale = TRUE;
 		return;
 	}
 
-	if (next_row->users > serv->gui->chanlist_maxusers
-		 && serv->gui->chanlist_maxusers > 0)
-	{
-		serv->gui->chanlist_caption_is_stale = TRUE;
-		return;
-	}
-
-	if (gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild))[0])
-	{
-		/* Check what the user wants to match. If both buttons or _neither_
-		 * button is checked, look for match in both by default. 
-		 */
-		if (serv->gui->chanlist_match_wants_channel ==
-			 serv->gui->chanlist_match_wants_topic)
-		{
-			if (!chanlist_match (serv, GET_CHAN (next_row))
-				 && !chanlist_match (serv, next_row->topic))
-			{
-				serv->gui->chanlist_caption_is_stale = TRUE;
-				return;
-			}
-		}
-
-		else if (serv->gui->chanlist_match_wants_channel)
-		{
-			if (!chanlist_match (serv, GET_CHAN (next_row)))
-			{
-				serv->gui->chanlist_caption_is_stale = TRUE;
-				return;
-			}
-		}
-
-		else if (serv->gui->chanlist_match_wants_topic)
-		{
-			if (!chanlist_match (serv, next_row->topic))
-			{
-				serv->gui->chanlist_caption_is_stale = TRUE;
-				return;
-			}
-		}
-	}
-
-	if (force || serv->gui->chanlist_channels_shown_count < 20)
+	if (serv->gui->chanlist_channels_shown_count < 20)
 	{
 		model = GET_MODEL (serv);
 		/* makes it appear fast :) */
@@ -325,74 +643,71 @@ chanlist_refresh (GtkWidget * wid, server *serv)
 }
 
 /**
- * Fills the gui GtkTreeView with stored items from the GSList.
+ * Refills the gui GtkTreeView from the stored rows. The matching and sorting
+ * is done by chanlist_filter_thread.
  */
 static void
 chanlist_build_gui_list (server *serv)
 {
-	GSList *rows;
-
 	/* first check if the list is present */
-	if (serv->gui->chanlist_data_stored_rows == NULL)
+	if (serv->gui->chanlist_store == NULL)
 	{
 		/* start a download */
 		chanlist_do_refresh (serv);
 		return;
 	}
 
+	chanlist_filter_stop (serv);
 	custom_list_clear ((CustomList *)GET_MODEL (serv));
 
-	/* discard pending rows FIXME: free the structs? */
+	/* discard pending rows, they're in the store too */
 	g_slist_free (serv->gui->chanlist_pending_rows);
 	serv->gui->chanlist_pending_rows = NULL;
 
-	/* Reset the counters */
+	/* Reset the counters, everything stored has been found */
 	chanlist_reset_counters (serv);
+	serv->gui->chanlist_users_found_count = serv->gui->chanlist_store->users;
+	serv->gui->chanlist_channels_found_count = serv->gui->chanlist_store->count;
+	chanlist_update_caption (serv);
 
 	/* Refill the list */
-	for (rows = serv->gui->chanlist_data_stored_rows; rows != NULL;
-		  rows = rows->next)
-	{
-		chanlist_place_row_in_gui (serv, rows->data, TRUE);
-	}
-
-	custom_list_resort ((CustomList *)GET_MODEL (serv));
+	chanlist_filter_start (serv, NULL, 0);
 }
 
 /**
- * Accepts incoming channel data from inbound.c, allocates new space for a
- * chanlistrow, adds it to our linked list and calls chanlist_place_row_in_gui.
+ * Accepts incoming channel data from inbound.c, adds it to the store and
+ * calls chanlist_place_row_in_gui.
  */
 void
 fe_add_chan_list (server *serv, char *chan, char *users, char *topic)
 {
 	chanlistrow *next_row;
-	int len = strlen (chan) + 1;
 
-	/* we allocate the struct and channel string in one go */
-	next_row = g_malloc (sizeof (chanlistrow) + len);
-	memcpy (((char *)next_row) + sizeof (chanlistrow), chan, len);
-	next_row->topic = strip_color (topic, -1, STRIP_ALL);
-	next_row->collation_key = g_utf8_collate_key (chan, len-1);
-	if (!(next_row->collation_key))
-		next_row->collation_key = g_strdup (chan);
-	next_row->users = atoi (users);
+	if (!serv->gui->chanlist_store)
+		serv->gui->chanlist_store = chanlist_store_new ();
 
-	/* add this row to the data */
-	serv->gui->chanlist_data_stored_rows =
-		g_slist_prepend (serv->gui->chanlist_data_stored_rows, next_row);
+	next_row = chanlist_store_add (serv->gui->chanlist_store, chan, atoi (users), topic);
 
 	/* _possibly_ add the row to the gui */
-	chanlist_place_row_in_gui (serv, next_row, FALSE);
+	chanlist_place_row_in_gui (serv, next_row);
 }
 
 void
 fe_chan_list_end (server *serv)
 {
+	CustomList *model = (CustomList *) GET_MODEL (serv);
+
 	/* download complete */
 	chanlist_flush_pending (serv);
 	gtk_widget_set_sensitive (serv->gui->chanlist_refresh, TRUE);
-	custom_list_resort ((CustomList *)GET_MODEL (serv));
+
+	/* a running refilter sorts when it's done, otherwise sort in a thread too */
+	if (serv->gui->chanlist_filter)
+		return;
+
+	if (serv->gui->chanlist_store && model->num_rows > 1)
+		chanlist_filter_start (serv, chanlist_rows_dup ((gpointer *) model->rows, model->num_rows),
+									  model->num_rows);
 }
 
 static void
@@ -723,7 +1038,8 @@ chanlist_opengui (server *serv, int do_refresh)
 	serv->gui->chanlist_pending_rows = NULL;
 	serv->gui->chanlist_tag = 0;
 	serv->gui->chanlist_flash_tag = 0;
-	serv->gui->chanlist_data_stored_rows = NULL;
+	serv->gui->chanlist_store = NULL;
+	serv->gui->chanlist_filter = NULL;
 
 	if (!serv->gui->chanlist_minusers)
 	{
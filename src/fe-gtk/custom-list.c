@@ -391,7 +391,7 @@ custom_list_get_value (GtkTreeModel * tree_model,
 	switch (column)
 	{
 	case CUSTOM_LIST_COL_NAME:
-		g_value_set_static_string (value, GET_CHAN (record));
+		g_value_set_static_string (value, record->chan);
 		break;
 
 	case CUSTOM_LIST_COL_USERS:
@@ -639,28 +639,61 @@ fast_ascii_stricmp (const char *s1, const char *s2)
 	return (((int) (unsigned char) *s1) - ((int) (unsigned char) *s2));
 }
 
-static gint
-custom_list_qsort_compare_func (chanlistrow ** a, chanlistrow ** b,
-										  CustomList * custom_list)
+/* Collation keys are only needed to sort by name, so they're made on first
+ * use. chanlist.c sorts from a worker thread too, hence the atomics: if both
+ * threads get here at once, the loser throws its copy away. */
+
+const char *
+custom_list_collation_key (chanlistrow *row)
 {
-	if (custom_list->sort_order == GTK_SORT_DESCENDING)
+	char *key = g_atomic_pointer_get (&row->collation_key);
+
+	if (!key)
 	{
-		chanlistrow **tmp = a;
+		key = g_utf8_collate_key (row->chan, -1);
+		if (!key)
+			key = g_strdup (row->chan);
+
+		if (!g_atomic_pointer_compare_and_exchange (&row->collation_key, NULL, key))
+		{
+			g_free (key);
+			key = g_atomic_pointer_get (&row->collation_key);
+		}
+	}
+
+	return key;
+}
+
+gint
+custom_list_compare_rows (chanlistrow *a, chanlistrow *b,
+								  gint sort_id, GtkSortType sort_order)
+{
+	if (sort_order == GTK_SORT_DESCENDING)
+	{
+		chanlistrow *tmp = a;
 		a = b;
 		b = tmp;
 	}
 
-	if (custom_list->sort_id == SORT_ID_USERS)
+	if (sort_id == SORT_ID_USERS)
 	{
-		return (*a)->users - (*b)->users;
+		return a->users - b->users;
 	}
 
-	if (custom_list->sort_id == SORT_ID_TOPIC)
+	if (sort_id == SORT_ID_TOPIC)
 	{
-		return fast_ascii_stricmp ((*a)->topic, (*b)->topic);
+		return fast_ascii_stricmp (a->topic, b->topic);
 	}
 
-	return strcmp ((*a)->collation_key, (*b)->collation_key);
+	return strcmp (custom_list_collation_key (a), custom_list_collation_key (b));
+}
+
+static gint
+custom_list_qsort_compare_func (chanlistrow ** a, chanlistrow ** b,
+										  CustomList * custom_list)
+{
+	return custom_list_compare_rows (*a, *b, custom_list->sort_id,
+												custom_list->sort_order);
 }
 
 /*****************************************************************************
@@ -747,6 +780,40 @@ custom_list_resort (CustomList * custom_list)
 	g_free (neworder);
 }
 
+/* Takes an order sorted elsewhere (see chanlist.c); it must hold exactly the
+ * rows in the list. Returns FALSE if the list has gained rows since. */
+
+gboolean
+custom_list_reorder (CustomList * custom_list, chanlistrow ** sorted, guint count)
+{
+	GtkTreePath *path;
+	gint *neworder;
+	guint i;
+
+	if (count != custom_list->num_rows)
+		return FALSE;
+
+	if (count <= 1)
+		return TRUE;
+
+	neworder = g_new (gint, count);
+
+	for (i = 0; i < count; i++)
+	{
+		neworder[i] = sorted[i]->pos;
+		sorted[i]->pos = i;
+		custom_list->rows[i] = sorted[i];
+	}
+
+	path = gtk_tree_path_new ();
+	gtk_tree_model_rows_reordered (GTK_TREE_MODEL (custom_list), path, NULL,
+											 neworder);
+	gtk_tree_path_free (path);
+	g_free (neworder);
+
+	return TRUE;
+}
+
 void
 custom_list_clear (CustomList * custom_list)
 {
@@ -53,12 +53,11 @@ enum
 
 typedef struct
 {
-	char *topic;
-	char *collation_key;
+	const char *chan;					  /* both strings are owned by chanlist.c */
+	const char *topic;
+	char *collation_key;				  /* NULL until first sorted by name */
 	guint32 pos;						  /* pos within the array */
 	guint32 users;
-	/* channel string lives beyond "users" */
-#define GET_CHAN(row) (((char *)row)+sizeof(chanlistrow))
 }
 chanlistrow;
 
@@ -102,5 +101,8 @@ CustomList *custom_list_new (void);
 void custom_list_append (CustomList *, chanlistrow *);
 void custom_list_resort (CustomList *);
 void custom_list_clear (CustomList *);
+gboolean custom_list_reorder (CustomList *, chanlistrow **sorted, guint count);
+const char *custom_list_collation_key (chanlistrow *);
+gint custom_list_compare_rows (chanlistrow *, chanlistrow *, gint sort_id, GtkSortType sort_order);
 
 #endif /* HEXCHAT_CUSTOM_LIST_H */
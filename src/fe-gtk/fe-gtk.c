@@ -641,10 +641,25 @@ void fe_lastlog(session *sess, session *lastlog_sess, char *sstr,
                 gtk_xtext_search_flags flags) {
   GError *err = NULL;
   xtext_buffer *buf, *lbuf;
+  GSList *list;
+  session *s;
+  char *title;
 
   buf = sess->res->buffer;
 
-  if (gtk_xtext_is_empty(buf)) {
+  if (flags & all_tabs) {
+    for (list = sess_list; list; list = list->next) {
+      s = list->data;
+      if (s->server == sess->server && s != lastlog_sess &&
+          !gtk_xtext_is_empty(s->res->buffer)) {
+        break;
+      }
+    }
+    if (list == NULL) {
+      PrintText(lastlog_sess, _("Search buffer is empty.\n"));
+      return;
+    }
+  } else if (gtk_xtext_is_empty(buf)) {
     PrintText(lastlog_sess, _("Search buffer is empty.\n"));
     return;
   }
@@ -669,7 +684,23 @@ void fe_lastlog(session *sess, session *lastlog_sess, char *sstr,
   }
   lbuf->search_flags = flags;
   lbuf->search_text = g_strdup(sstr);
-  gtk_xtext_lastlog(lbuf, buf);
+
+  if (!(flags & all_tabs)) {
+    gtk_xtext_lastlog(lbuf, buf, NULL);
+    return;
+  }
+
+  /* One pass over every tab of the network, each one titled by its name */
+  for (list = sess_list; list; list = list->next) {
+    s = list->data;
+    if (s->server != sess->server || s == lastlog_sess) {
+      continue;
+    }
+    title = g_strdup_printf("\002%s\002",
+                            s->channel[0] ? s->channel : s->server->servername);
+    gtk_xtext_lastlog(lbuf, s->res->buffer, title);
+    g_free(title);
+  }
 }
 
 void fe_set_lag(server *serv, long lag) {
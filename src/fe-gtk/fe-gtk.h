@@ -74,7 +74,8 @@ struct server_gui
 	GtkWidget *chanlist_savelist;
 	GtkWidget *chanlist_search;
 
-	GSList *chanlist_data_stored_rows;	/* stored list so it can be resorted  */
+	struct chanlist_store *chanlist_store;	/* every row of the last LIST, so it can be refiltered */
+	struct chanlist_filter *chanlist_filter;	/* refilter running in a worker thread */
 	GSList *chanlist_pending_rows;
 	gint chanlist_tag;
 	gint chanlist_flash_tag;
@@ -108,6 +109,7 @@ typedef struct restore_gui
 
 	/* information stored when this tab isn't front-most */
 	GtkListStore *user_model;	/* for filling the GtkTreeView */
+	GHashTable *user_rows;	/* struct User -> GtkTreeIter in user_model */
 	void *buffer;		/* xtext_Buffer */
 	char *input_text;	/* input text buffer (while not-front tab) */
 	char *topic_text;	/* topic GtkEntry buffer */
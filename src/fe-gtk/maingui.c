@@ -3684,6 +3684,7 @@ fe_session_callback (session *sess)
 {
 	gtk_xtext_buffer_free (sess->res->buffer);
 	g_object_unref (G_OBJECT (sess->res->user_model));
+	g_hash_table_destroy (sess->res->user_rows);
 
 	if (sess->res->banlist && sess->res->banlist->window)
 		mg_close_gen (NULL, sess->res->banlist->window);
@@ -540,6 +540,7 @@ static const setting general_settings[] =
 	{ST_TOGGLE,	N_("WHOIS on notify"), P_OFFINTNL(hex_notify_whois_online), N_("Sends a /WHOIS when a user comes online in your notify list."), 0, 0},
 	{ST_TOGGLE,	N_("Hide join and part messages"), P_OFFINTNL(hex_irc_conf_mode), N_("Hide channel join/part messages by default."), 0, 0},
 	{ST_TOGGLE,	N_("Hide nick change messages"), P_OFFINTNL(hex_irc_hide_nickchange), 0, 0, 0},
+	{ST_TOGGLE,	N_("Summarize netsplits"), P_OFFINTNL(hex_irc_netsplit_summary), N_("Show one line per channel for the users lost in a netsplit and for their return, instead of a quit or join for each."), 0, 0},
 
 	{ST_END, 0, 0, 0, 0, 0}
 };
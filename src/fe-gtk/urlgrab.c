@@ -27,7 +27,6 @@
 #include "../common/cfgfiles.h"
 #include "../common/fe.h"
 #include "../common/url.h"
-#include "../common/tree.h"
 #include "gtkutil.h"
 #include "menu.h"
 #include "maingui.h"
@@ -176,11 +175,10 @@ fe_url_add (const char *urltext)
 	}
 }
 
-static int
+static void
 populate_cb (char *urltext, gpointer userdata)
 {
 	fe_url_add (urltext);
-	return TRUE;
 }
 
 void
@@ -220,7 +218,7 @@ url_opengui ()
 	gtk_widget_show (urlgrabberwindow);
 
 	if (prefs.hex_url_grabber)
-		tree_foreach (url_tree, (tree_traverse_func *)populate_cb, NULL);
+		g_queue_foreach (&url_queue, (GFunc)populate_cb, NULL);
 	else
 	{
 		gtk_list_store_clear (GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (view))));
@@ -235,33 +235,24 @@ fe_userlist_set_selected (struct session *sess)
 	}
 }
 
+/* the rows of a GtkListStore stay valid while sorting, so each user's row
+   is kept in sess->res->user_rows instead of searching the model */
+
 static GtkTreeIter *
-find_row (GtkTreeView *treeview, GtkTreeModel *model, struct User *user,
-			 int *selected)
+find_row (session *sess, struct User *user, int *selected)
 {
-	static GtkTreeIter iter;
-	struct User *row_user;
+	GtkTreeView *treeview = GTK_TREE_VIEW (sess->gui->user_tree);
+	GtkTreeIter *iter;
 
 	*selected = FALSE;
-	if (gtk_tree_model_get_iter_first (model, &iter))
+	iter = g_hash_table_lookup (sess->res->user_rows, user);
+	if (iter && gtk_tree_view_get_model (treeview) == GTK_TREE_MODEL (sess->res->user_model))
 	{
-		do
-		{
-			gtk_tree_model_get (model, &iter, COL_USER, &row_user, -1);
-			if (row_user == user)
-			{
-				if (gtk_tree_view_get_model (treeview) == model)
-				{
-					if (gtk_tree_selection_iter_is_selected (gtk_tree_view_get_selection (treeview), &iter))
-						*selected = TRUE;
-				}
-				return &iter;
-			}
-		}
-		while (gtk_tree_model_iter_next (model, &iter));
+		if (gtk_tree_selection_iter_is_selected (gtk_tree_view_get_selection (treeview), iter))
+			*selected = TRUE;
 	}
 
-	return NULL;
+	return iter;
 }
 
 void
@@ -285,8 +276,7 @@ fe_userlist_remove (session *sess, struct User *user)
 	gfloat val, end;*/
 	int sel;
 
-	iter = find_row (GTK_TREE_VIEW (sess->gui->user_tree),
-						  GTK_TREE_MODEL(sess->res->user_model), user, &sel);
+	iter = find_row (sess, user, &sel);
 	if (!iter)
 		return 0;
 
@@ -294,6 +284,7 @@ fe_userlist_remove (session *sess, struct User *user)
 	val = adj->value;*/
 
 	gtk_list_store_remove (sess->res->user_model, iter);
+	g_hash_table_remove (sess->res->user_rows, user);
 
 	/* is it the front-most tab? */
 /*	if (gtk_tree_view_get_model (GTK_TREE_VIEW (sess->gui->user_tree))
@@ -315,8 +306,7 @@ fe_userlist_rehash (session *sess, struct User *user)
 	int sel;
 	int nick_color = 0;
 
-	iter = find_row (GTK_TREE_VIEW (sess->gui->user_tree),
-						  GTK_TREE_MODEL(sess->res->user_model), user, &sel);
+	iter = find_row (sess, user, &sel);
 	if (!iter)
 		return;
 
@@ -336,7 +326,7 @@ fe_userlist_insert (session *sess, struct User *newuser, gboolean sel)
 {
 	GtkTreeModel *model = GTK_TREE_MODEL(sess->res->user_model);
 	GdkPixbuf *pix = get_user_icon (sess->server, newuser);
-	GtkTreeIter iter;
+	GtkTreeIter iter, *row;
 	char *nick;
 	int nick_color = 0;
 
@@ -365,6 +355,10 @@ fe_userlist_insert (session *sess, struct User *newuser, gboolean sel)
 									COL_GDKCOLOR, nick_color ? &colors[nick_color] : NULL,
 								  -1);
 
+	row = g_new (GtkTreeIter, 1);
+	*row = iter;
+	g_hash_table_insert (sess->res->user_rows, newuser, row);
+
 	if (!prefs.hex_gui_ulist_icons)
 	{
 		g_free (nick);
@@ -387,10 +381,37 @@ fe_userlist_insert (session *sess, struct User *newuser, gboolean sel)
 	}
 }
 
+/* a whole NAMES reply at once: with the store unsorted each row is a plain
+   append, and it gets sorted once when the sort column is put back */
+
+void
+fe_userlist_insert_list (session *sess, GPtrArray *users)
+{
+	GtkTreeSortable *sortable = GTK_TREE_SORTABLE (sess->res->user_model);
+	GtkSortType sort_type;
+	gint sort_column;
+	gboolean sorted;
+	guint i;
+
+	/* the usual default sort column doesn't count as "sorted" for GTK */
+	gtk_tree_sortable_get_sort_column_id (sortable, &sort_column, &sort_type);
+	sorted = sort_column != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+	if (sorted)
+		gtk_tree_sortable_set_sort_column_id (sortable,
+						GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, sort_type);
+
+	for (i = 0; i < users->len; i++)
+		fe_userlist_insert (sess, g_ptr_array_index (users, i), FALSE);
+
+	if (sorted)
+		gtk_tree_sortable_set_sort_column_id (sortable, sort_column, sort_type);
+}
+
 void
 fe_userlist_clear (session *sess)
 {
 	gtk_list_store_clear (sess->res->user_model);
+	g_hash_table_remove_all (sess->res->user_rows);
 }
 
 static void
@@ -476,6 +497,8 @@ userlist_create_model (session *sess)
 
 	store = gtk_list_store_new (5, GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_STRING,
 										G_TYPE_POINTER, GDK_TYPE_COLOR);
+	sess->res->user_rows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+																 NULL, g_free);
 
 	switch (prefs.hex_gui_ulist_sort)
 	{
@@ -70,6 +70,36 @@
 
 static GtkWidgetClass *parent_class = NULL;
 
+/* Lines are carved out of chunks, oldest first, with the text right after
+   each textentry. A chunk is freed once all of its lines are gone, which
+   for scrollback trimmed from the top means whole chunks at a time. */
+
+#define XTEXT_CHUNK_SIZE 16384
+#define XTEXT_ALIGN(n) (((n) + 7) & ~(gsize)7)
+
+struct xtext_chunk {
+  gsize size;
+  gsize used;
+  int live; /* textentries not freed yet */
+};
+
+/* Once a buffer has been searched, each of its lines gets a small bloom
+   filter of the case-folded byte pairs in its stripped text, so the next
+   literal search can pass over lines that lack one of the needle's pairs
+   without stripping and folding them. Buffers nobody searches pay nothing. */
+
+#define XTEXT_GRAM_BITS 256
+#define XTEXT_GRAM(a, b)                                                       \
+  (((g_ascii_tolower(a) * 33) ^ g_ascii_tolower(b)) & (XTEXT_GRAM_BITS - 1))
+
+#define GRAMS_ALL 1       /* hidden text, any needle may match */
+#define GRAMS_NON_ASCII 2 /* casefolding could turn it into pairs we lack */
+
+struct xtext_grams {
+  guint32 bits[XTEXT_GRAM_BITS / 32];
+  guchar flags;
+};
+
 struct textentry {
   struct textentry *next;
   struct textentry *prev;
@@ -81,11 +111,13 @@ struct textentry {
   gint16 mark_end;
   gint16 indent;
   gint16 left_len;
+  gint16 num_sublines;
+  gint16 subline_end; /* sublines points here for unwrapped lines */
+  gint16 *sublines;   /* end offset of each wrapped line */
   GSList *slp;
-  GSList *sublines;
+  struct xtext_chunk *chunk;
   guchar tag;
-  guchar pad1;
-  guchar pad2;  /* 32-bit align : 44 bytes total */
+  guchar unmeasured; /* str_width, slp and sublines not worked out yet */
   GList *marks; /* List of found strings */
 };
 
@@ -98,6 +130,38 @@ static guint xtext_signals[LAST_SIGNAL];
 
 char *nocasestrstr(const char *text, const char *tofind); /* util.c */
 int xtext_get_stamp_str(time_t, char **);
+
+/* offset where wrapped line n of ent ends, 0 past the last one */
+
+static int gtk_xtext_subline_end(textentry *ent, int n) {
+  if (n < 0 || n >= ent->num_sublines)
+    return 0;
+  return ent->sublines[n];
+}
+
+static void gtk_xtext_sublines_clear(textentry *ent) {
+  if (ent->sublines != &ent->subline_end)
+    g_free(ent->sublines);
+  ent->sublines = NULL;
+  ent->num_sublines = 0;
+}
+
+static void gtk_xtext_sublines_add(textentry *ent, int end) {
+  int n = ent->num_sublines;
+
+  if (n == 0) {
+    /* the usual case, no allocation */
+    ent->sublines = &ent->subline_end;
+  } else if (n == 1) {
+    ent->sublines = g_new(gint16, 4);
+    ent->sublines[0] = ent->subline_end;
+  } else if (n >= 4 && (n & (n - 1)) == 0) {
+    ent->sublines = g_renew(gint16, ent->sublines, n * 2);
+  }
+
+  ent->sublines[n] = end;
+  ent->num_sublines++;
+}
 static void gtk_xtext_render_page(GtkXText *xtext);
 static void gtk_xtext_calc_lines(xtext_buffer *buf, int);
 static gboolean gtk_xtext_is_selecting(GtkXText *xtext);
@@ -759,7 +823,7 @@ static int find_x(GtkXText *xtext, textentry *ent, int x, int subline,
 
   /* Skip to the first chunk of stuff for the subline */
   if (subline > 0) {
-    suboff = GPOINTER_TO_INT(g_slist_nth_data(ent->sublines, subline - 1));
+    suboff = gtk_xtext_subline_end(ent, subline - 1);
     for (list = ent->slp; list; list = g_slist_next(list)) {
       meta = list->data;
       if (meta->off + meta->len > suboff)
@@ -922,7 +986,7 @@ static void gtk_xtext_draw_marker(GtkXText *xtext, textentry *ent, int y) {
     render_y = y + xtext->font->descent;
   } else if (xtext->buffer->marker_pos == ent->next && ent->next != NULL) {
     render_y = y + xtext->font->descent +
-               xtext->fontsize * g_slist_length(ent->sublines);
+               xtext->fontsize * ent->num_sublines;
   } else
     return;
 
@@ -2954,7 +3018,7 @@ static int gtk_xtext_find_subline(GtkXText *xtext, textentry *ent, int line) {
   int rlen = 0;
 
   if (line > 0) {
-    rlen = GPOINTER_TO_UINT(g_slist_nth_data(ent->sublines, line - 1));
+    rlen = gtk_xtext_subline_end(ent, line - 1);
     if (rlen == 0)
       rlen = ent->str_len;
   }
@@ -3040,10 +3104,10 @@ static int gtk_xtext_render_line(GtkXText *xtext, textentry *ent, int line,
   /* draw each line one by one */
   do {
     if (entline > 0)
-      len = GPOINTER_TO_INT(g_slist_nth_data(ent->sublines, entline)) -
-            GPOINTER_TO_INT(g_slist_nth_data(ent->sublines, entline - 1));
+      len = gtk_xtext_subline_end(ent, entline) -
+            gtk_xtext_subline_end(ent, entline - 1);
     else
-      len = GPOINTER_TO_INT(g_slist_nth_data(ent->sublines, entline));
+      len = gtk_xtext_subline_end(ent, entline);
 
     entline++;
 
@@ -3054,7 +3118,7 @@ static int gtk_xtext_render_line(GtkXText *xtext, textentry *ent, int line,
         /* small optimization */
         gtk_xtext_draw_marker(
             xtext, ent, y - xtext->fontsize * (taken + start_subline + 1));
-        return g_slist_length(ent->sublines) - subline;
+        return ent->num_sublines - subline;
       }
     } else {
       xtext->dont_render = TRUE;
@@ -3115,15 +3179,12 @@ static void gtk_xtext_fix_indent(xtext_buffer *buf) {
   dontscroll(buf); /* force scrolling off */
 }
 
-static void gtk_xtext_recalc_widths(xtext_buffer *buf, int do_str_width) {
+/* the separator moved, so line up the left part of each line again */
+
+static void gtk_xtext_recalc_indents(xtext_buffer *buf) {
   textentry *ent;
 
-  /* since we have a new font, we have to recalc the text widths */
-  ent = buf->text_first;
-  while (ent) {
-    if (do_str_width) {
-      ent->str_width = gtk_xtext_text_width_ent(buf->xtext, ent);
-    }
+  for (ent = buf->text_first; ent; ent = ent->next) {
     if (ent->left_len != -1) {
       ent->indent = (buf->indent - gtk_xtext_text_width(buf->xtext, ent->str,
                                                         ent->left_len)) -
@@ -3131,9 +3192,21 @@ static void gtk_xtext_recalc_widths(xtext_buffer *buf, int do_str_width) {
       if (ent->indent < MARGIN)
         ent->indent = MARGIN;
     }
-    ent = ent->next;
   }
+}
+
+static void gtk_xtext_recalc_widths(xtext_buffer *buf, int do_str_width) {
+  textentry *ent;
 
+  /* since we have a new font, we have to recalc the text widths */
+  for (ent = buf->text_first; ent; ent = ent->next) {
+    if (do_str_width || ent->unmeasured) {
+      ent->str_width = gtk_xtext_text_width_ent(buf->xtext, ent);
+      ent->unmeasured = FALSE;
+    }
+  }
+
+  gtk_xtext_recalc_indents(buf);
   gtk_xtext_calc_lines(buf, FALSE);
 }
 
@@ -3217,13 +3290,16 @@ static int gtk_xtext_lines_taken(xtext_buffer *buf, textentry *ent) {
   int indent, len;
   int win_width;
 
-  g_slist_free(ent->sublines);
-  ent->sublines = NULL;
+  if (ent->unmeasured) {
+    ent->str_width = gtk_xtext_text_width_ent(buf->xtext, ent);
+    ent->unmeasured = FALSE;
+  }
+
+  gtk_xtext_sublines_clear(ent);
   win_width = buf->window_width - MARGIN;
 
   if (win_width >= ent->indent + ent->str_width) {
-    ent->sublines =
-        g_slist_append(ent->sublines, GINT_TO_POINTER(ent->str_len));
+    gtk_xtext_sublines_add(ent, ent->str_len);
     return 1;
   }
 
@@ -3232,13 +3308,30 @@ static int gtk_xtext_lines_taken(xtext_buffer *buf, textentry *ent) {
 
   do {
     len = find_next_wrap(buf->xtext, ent, str, win_width, indent);
-    ent->sublines =
-        g_slist_append(ent->sublines, GINT_TO_POINTER(str + len - ent->str));
+    gtk_xtext_sublines_add(ent, str + len - ent->str);
     indent = buf->indent;
     str += len;
   } while (str < ent->str + ent->str_len);
 
-  return g_slist_length(ent->sublines);
+  return ent->num_sublines;
+}
+
+/* Lines appended while the buffer was hidden are all at the end. Measure
+   and wrap them for real now. */
+
+static void gtk_xtext_layout_pending(xtext_buffer *buf) {
+  textentry *ent = buf->text_last;
+
+  if (!ent || !ent->unmeasured)
+    return;
+
+  while (ent->prev && ent->prev->unmeasured)
+    ent = ent->prev;
+
+  for (; ent; ent = ent->next) {
+    buf->num_lines -= ent->num_sublines;
+    buf->num_lines += gtk_xtext_lines_taken(buf, ent);
+  }
 }
 
 /* Calculate number of actual lines (with wraps), to set adj->lower. *
@@ -3299,7 +3392,7 @@ static textentry *gtk_xtext_nth(GtkXText *xtext, int line, int *subline) {
         ent = ent->prev;
         if (!ent)
           break;
-        lines -= g_slist_length(ent->sublines);
+        lines -= ent->num_sublines;
       }
       return NULL;
     }
@@ -3307,9 +3400,9 @@ static textentry *gtk_xtext_nth(GtkXText *xtext, int line, int *subline) {
   /* -- end of optimization -- */
 
   while (ent) {
-    lines += g_slist_length(ent->sublines);
+    lines += ent->num_sublines;
     if (lines > line) {
-      *subline = g_slist_length(ent->sublines) - (lines - line);
+      *subline = ent->num_sublines - (lines - line);
       return ent;
     }
     ent = ent->next;
@@ -3379,7 +3472,7 @@ static int gtk_xtext_render_ents(GtkXText *xtext, textentry *enta,
         line -= subline;
         subline = 0;
       }
-      line += g_slist_length(ent->sublines);
+      line += ent->num_sublines;
     }
 
     if (ent == entb)
@@ -3508,6 +3601,48 @@ void gtk_xtext_refresh(GtkXText *xtext) {
   }
 }
 
+/* a textentry with room for size bytes of text after it */
+
+static textentry *gtk_xtext_ent_new(xtext_buffer *buf, gsize size) {
+  struct xtext_chunk *chunk = buf->chunk_last;
+  textentry *ent;
+
+  size = XTEXT_ALIGN(sizeof(textentry) + size);
+
+  if (!chunk || chunk->used + size > chunk->size) {
+    /* the old one lives on until its last line is freed */
+    if (chunk && !chunk->live)
+      g_free(chunk);
+
+    chunk = g_malloc(MAX(XTEXT_CHUNK_SIZE,
+                         XTEXT_ALIGN(sizeof(struct xtext_chunk)) + size));
+    chunk->size = MAX(XTEXT_CHUNK_SIZE,
+                      XTEXT_ALIGN(sizeof(struct xtext_chunk)) + size);
+    chunk->used = XTEXT_ALIGN(sizeof(struct xtext_chunk));
+    chunk->live = 0;
+    buf->chunk_last = chunk;
+  }
+
+  ent = (textentry *)((char *)chunk + chunk->used);
+  chunk->used += size;
+  chunk->live++;
+  ent->chunk = chunk;
+
+  return ent;
+}
+
+static void gtk_xtext_ent_free(xtext_buffer *buf, textentry *ent) {
+  struct xtext_chunk *chunk = ent->chunk;
+
+  if (--chunk->live)
+    return;
+
+  if (chunk == buf->chunk_last)
+    chunk->used = XTEXT_ALIGN(sizeof(struct xtext_chunk)); /* start over */
+  else
+    g_free(chunk);
+}
+
 static int gtk_xtext_kill_ent(xtext_buffer *buffer, textentry *ent) {
   int visible;
 
@@ -3540,10 +3675,15 @@ static int gtk_xtext_kill_ent(xtext_buffer *buffer, textentry *ent) {
     gtk_xtext_search_textentry_del(buffer, ent);
   }
 
+  /* its memory may hold a new line soon */
+  if (buffer->grams) {
+    g_hash_table_remove(buffer->grams, ent);
+  }
+
   g_slist_free_full(ent->slp, g_free);
-  g_slist_free(ent->sublines);
+  gtk_xtext_sublines_clear(ent);
 
-  g_free(ent);
+  gtk_xtext_ent_free(buffer, ent);
   return visible;
 }
 
@@ -3555,21 +3695,21 @@ static void gtk_xtext_remove_top(xtext_buffer *buffer) {
   ent = buffer->text_first;
   if (!ent)
     return;
-  buffer->num_lines -= g_slist_length(ent->sublines);
-  buffer->pagetop_line -= g_slist_length(ent->sublines);
+  buffer->num_lines -= ent->num_sublines;
+  buffer->pagetop_line -= ent->num_sublines;
   buffer->last_pixel_pos -=
-      (g_slist_length(ent->sublines) * buffer->xtext->fontsize);
+      (ent->num_sublines * buffer->xtext->fontsize);
   buffer->text_first = ent->next;
   if (buffer->text_first)
     buffer->text_first->prev = NULL;
   else
     buffer->text_last = NULL;
 
-  buffer->old_value -= g_slist_length(ent->sublines);
+  buffer->old_value -= ent->num_sublines;
   if (buffer->xtext->buffer == buffer) /* is it the current buffer? */
   {
-    buffer->xtext->adj->value -= g_slist_length(ent->sublines);
-    buffer->xtext->select_start_adj -= g_slist_length(ent->sublines);
+    buffer->xtext->adj->value -= ent->num_sublines;
+    buffer->xtext->select_start_adj -= ent->num_sublines;
   }
 
   if (gtk_xtext_kill_ent(buffer, ent)) {
@@ -3593,7 +3733,7 @@ static void gtk_xtext_remove_bottom(xtext_buffer *buffer) {
   ent = buffer->text_last;
   if (!ent)
     return;
-  buffer->num_lines -= g_slist_length(ent->sublines);
+  buffer->num_lines -= ent->num_sublines;
   buffer->text_last = ent->prev;
   if (buffer->text_last)
     buffer->text_last->next = NULL;
@@ -3653,10 +3793,16 @@ void gtk_xtext_clear(xtext_buffer *buf, int lines) {
     if (buf->text_first)
       marker_reset = TRUE;
     dontscroll(buf);
+    if (buf->grams) {
+      g_hash_table_destroy(buf->grams);
+      buf->grams = NULL;
+    }
 
     while (buf->text_first) {
       next = buf->text_first->next;
-      g_free(buf->text_first);
+      g_slist_free_full(buf->text_first->slp, g_free);
+      gtk_xtext_sublines_clear(buf->text_first);
+      gtk_xtext_ent_free(buf, buf->text_first);
       buf->text_first = next;
     }
     buf->text_last = NULL;
@@ -3695,7 +3841,7 @@ static gboolean gtk_xtext_check_ent_visibility(GtkXText *xtext,
   lines = ((height + xtext->pixel_offset) / xtext->fontsize) +
           buf->pagetop_subline + add;
   while (ent) {
-    lines -= g_slist_length(ent->sublines);
+    lines -= ent->num_sublines;
     if (lines <= 0) {
       return FALSE;
     }
@@ -3755,6 +3901,78 @@ static void gtk_xtext_unstrip_color(gint start, gint end, GSList *slp,
   *gl = g_list_append(*gl, GUINT_TO_POINTER(marks.u));
 }
 
+/* Work out the byte pair filter of a textentry */
+static void gtk_xtext_index_entry(xtext_buffer *buf, textentry *ent,
+                                  struct xtext_grams *grams) {
+  unsigned char *stripped;
+  int len, i, g;
+
+  memset(grams, 0, sizeof(*grams));
+
+  /* Leaving hidden text out can join pairs that aren't in the index */
+  if (memchr(ent->str, ATTR_HIDDEN, ent->str_len)) {
+    grams->flags = GRAMS_ALL;
+    return;
+  }
+
+  stripped = gtk_xtext_strip_color(ent->str, ent->str_len,
+                                   buf->xtext->scratch_buffer, &len, NULL,
+                                   FALSE);
+  for (i = 0; i < len; i++) {
+    if (stripped[i] & 0x80) {
+      grams->flags |= GRAMS_NON_ASCII;
+    }
+    if (i > 0) {
+      g = XTEXT_GRAM(stripped[i - 1], stripped[i]);
+      grams->bits[g >> 5] |= 1u << (g & 31);
+    }
+  }
+}
+
+/* The filter of ent, made the first time a search looks at it */
+static struct xtext_grams *gtk_xtext_entry_grams(xtext_buffer *buf,
+                                                 textentry *ent) {
+  struct xtext_grams *grams;
+
+  if (!buf->grams) {
+    buf->grams = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  }
+
+  grams = g_hash_table_lookup(buf->grams, ent);
+  if (!grams) {
+    grams = g_new(struct xtext_grams, 1);
+    gtk_xtext_index_entry(buf, ent, grams);
+    g_hash_table_insert(buf->grams, ent, grams);
+  }
+  return grams;
+}
+
+/* Could the literal search needle of buf occur in ent? */
+static gboolean gtk_xtext_search_candidate(xtext_buffer *buf, textentry *ent) {
+  const guchar *nee = (const guchar *)buf->search_nee;
+  struct xtext_grams *grams = gtk_xtext_entry_grams(buf, ent);
+  int i, g;
+
+  if (grams->flags & GRAMS_ALL) {
+    return TRUE;
+  }
+  if (!(buf->search_flags & case_match) &&
+      (grams->flags & GRAMS_NON_ASCII)) {
+    return TRUE;
+  }
+
+  for (i = 1; i < buf->search_lnee; i++) {
+    if ((nee[i - 1] | nee[i]) & 0x80) {
+      continue;
+    }
+    g = XTEXT_GRAM(nee[i - 1], nee[i]);
+    if (!(grams->bits[g >> 5] & (1u << (g & 31)))) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
 /* Search a single textentry for occurrence(s) of search arg string */
 static GList *gtk_xtext_search_textentry(xtext_buffer *buf, textentry *ent) {
   gchar *str; /* text string to be searched */
@@ -3766,6 +3984,11 @@ static GList *gtk_xtext_search_textentry(xtext_buffer *buf, textentry *ent) {
     return gl;
   }
 
+  if (!(buf->search_flags & regexp) && buf->search_nee &&
+      !gtk_xtext_search_candidate(buf, ent)) {
+    return gl;
+  }
+
   str =
       gtk_xtext_strip_color(ent->str, ent->str_len, buf->xtext->scratch_buffer,
                             &lstr, &slp, !buf->xtext->ignore_hidden);
@@ -4032,12 +4255,12 @@ textentry *gtk_xtext_search(GtkXText *xtext, const gchar *text,
     buf->pagetop_ent = NULL;
     for (value = 0, ent = buf->text_first; ent && ent != buf->hintsearch;
          ent = ent->next) {
-      value += g_slist_length(ent->sublines);
+      value += ent->num_sublines;
     }
     if (value > adj->upper - adj->page_size) {
       value = adj->upper - adj->page_size;
     } else if ((flags & backward) && ent) {
-      value -= adj->page_size - g_slist_length(ent->sublines);
+      value -= adj->page_size - ent->num_sublines;
       if (value < 0) {
         value = 0;
       }
@@ -4099,7 +4322,6 @@ static void gtk_xtext_append_entry(xtext_buffer *buf, textentry *ent,
   if (stamp == 0)
     ent->stamp = time(0);
   ent->slp = NULL;
-  ent->str_width = gtk_xtext_text_width_ent(buf->xtext, ent);
   ent->mark_start = -1;
   ent->mark_end = -1;
   ent->next = NULL;
@@ -4117,7 +4339,18 @@ static void gtk_xtext_append_entry(xtext_buffer *buf, textentry *ent,
   buf->text_last = ent;
 
   ent->sublines = NULL;
-  buf->num_lines += gtk_xtext_lines_taken(buf, ent);
+  ent->num_sublines = 0;
+  if (buf->xtext->buffer == buf) {
+    ent->unmeasured = FALSE;
+    ent->str_width = gtk_xtext_text_width_ent(buf->xtext, ent);
+    buf->num_lines += gtk_xtext_lines_taken(buf, ent);
+  } else {
+    /* Nobody is looking, so skip the Pango work and count it as one
+       line. gtk_xtext_buffer_show() lays it out properly. */
+    ent->unmeasured = TRUE;
+    gtk_xtext_sublines_add(ent, ent->str_len);
+    buf->num_lines++;
+  }
 
   if ((buf->marker_pos == NULL || buf->marker_seen) &&
       (buf->xtext->buffer != buf ||
@@ -4185,7 +4418,7 @@ void gtk_xtext_append_indent(xtext_buffer *buf, unsigned char *left_text,
   if (right_text[right_len - 1] == '\n')
     right_len--;
 
-  ent = g_malloc(left_len + right_len + 2 + sizeof(textentry));
+  ent = gtk_xtext_ent_new(buf, left_len + right_len + 2);
   str = (unsigned char *)ent + sizeof(textentry);
 
   if (left_len)
@@ -4222,7 +4455,10 @@ void gtk_xtext_append_indent(xtext_buffer *buf, unsigned char *left_text,
       buf->indent = buf->xtext->max_auto_indent;
 
     gtk_xtext_fix_indent(buf);
-    gtk_xtext_recalc_widths(buf, FALSE);
+    if (buf->xtext->buffer == buf)
+      gtk_xtext_recalc_widths(buf, FALSE);
+    else
+      buf->needs_indent = TRUE; /* done in gtk_xtext_buffer_show() */
 
     ent->indent = (buf->indent - left_width) - buf->xtext->space_width;
     buf->xtext->force_render = TRUE;
@@ -4247,7 +4483,7 @@ void gtk_xtext_append(xtext_buffer *buf, unsigned char *text, int len,
     truncate = TRUE;
   }
 
-  ent = g_malloc(len + 1 + sizeof(textentry));
+  ent = gtk_xtext_ent_new(buf, len + 1);
   ent->str = (unsigned char *)ent + sizeof(textentry);
   ent->str_len = len;
   if (len) {
@@ -4269,17 +4505,25 @@ gboolean gtk_xtext_is_empty(xtext_buffer *buf) {
   return buf->text_first == NULL;
 }
 
-int gtk_xtext_lastlog(xtext_buffer *out, xtext_buffer *search_area) {
+/* Copy the lines of search_area that match the search set up in out.
+   When given, title is put before the first match; the results of
+   earlier calls on the same out buffer are kept. */
+int gtk_xtext_lastlog(xtext_buffer *out, xtext_buffer *search_area,
+                      const char *title) {
   textentry *ent;
   int matches;
   GList *gl;
 
   ent = search_area->text_first;
   matches = 0;
+  out->search_found = g_list_reverse(out->search_found);
 
   while (ent) {
     gl = gtk_xtext_search_textentry(out, ent);
     if (gl) {
+      if (matches == 0 && title) {
+        gtk_xtext_append(out, (unsigned char *)title, -1, 0);
+      }
       matches++;
       /* copy the text over */
       if (search_area->xtext->auto_indent) {
@@ -4378,7 +4622,7 @@ int gtk_xtext_moveto_marker_pos(GtkXText *xtext) {
     while (ent) {
       if (ent == buf->marker_pos)
         break;
-      value += g_slist_length(ent->sublines);
+      value += ent->num_sublines;
       ent = ent->next;
     }
     if (value >= adj->value && value < adj->value + adj->page_size)
@@ -4402,6 +4646,7 @@ int gtk_xtext_moveto_marker_pos(GtkXText *xtext) {
 
 void gtk_xtext_buffer_show(GtkXText *xtext, xtext_buffer *buf, int render) {
   int w, h;
+  gboolean reindented;
 
   buf->xtext = xtext;
 
@@ -4429,7 +4674,22 @@ void gtk_xtext_buffer_show(GtkXText *xtext, xtext_buffer *buf, int render) {
   /* after a font change */
   if (buf->needs_recalc) {
     buf->needs_recalc = FALSE;
+    buf->needs_indent = FALSE;
     gtk_xtext_recalc_widths(buf, TRUE);
+  } else {
+    /* the separator moved while hidden, the text widths still hold */
+    reindented = buf->needs_indent;
+    if (reindented) {
+      buf->needs_indent = FALSE;
+      gtk_xtext_recalc_indents(buf);
+    }
+
+    /* a new width below relays out everything anyway */
+    if (!render || buf->window_width == w) {
+      if (reindented)
+        gtk_xtext_calc_lines(buf, FALSE);
+      gtk_xtext_layout_pending(buf);
+    }
   }
 
   /* now change to the new buffer */
@@ -4460,6 +4720,7 @@ void gtk_xtext_buffer_show(GtkXText *xtext, xtext_buffer *buf, int render) {
       buf->window_width = w;
       buf->window_height = h;
       gtk_xtext_calc_lines(buf, FALSE);
+      gtk_xtext_layout_pending(buf); /* if calc_lines() gave up */
       if (buf->scrollbar_down)
         gtk_adjustment_set_value(xtext->adj,
                                  xtext->adj->upper - xtext->adj->page_size);
@@ -4505,9 +4766,16 @@ void gtk_xtext_buffer_free(xtext_buffer *buf) {
   ent = buf->text_first;
   while (ent) {
     next = ent->next;
-    g_free(ent);
+    g_slist_free_full(ent->slp, g_free);
+    gtk_xtext_sublines_clear(ent);
+    gtk_xtext_ent_free(buf, ent);
     ent = next;
   }
 
+  if (buf->grams) {
+    g_hash_table_destroy(buf->grams);
+  }
+
+  g_free(buf->chunk_last);
   g_free(buf);
 }
@@ -83,6 +83,7 @@ typedef struct {
 	gfloat old_value;					/* last known adj->value */
 	textentry *text_first;
 	textentry *text_last;
+	struct xtext_chunk *chunk_last;	/* where new textentries are allocated */
 
 	textentry *last_ent_start;	  /* this basically describes the last rendered */
 	textentry *last_ent_end;	  /* selection. */
@@ -107,6 +108,7 @@ typedef struct {
 	unsigned int time_stamp:1;
 	unsigned int scrollbar_down:1;
 	unsigned int needs_recalc:1;
+	unsigned int needs_indent:1;	/* separator moved while hidden */
 	unsigned int marker_seen:1;
 
 	GList *search_found;		/* list of textentries where search found strings */
@@ -119,6 +121,7 @@ typedef struct {
 	offsets_t curdata;		/* current offset info, from *curmark */
 	GRegex *search_re;		/* Compiled regular expression */
 	textentry *hintsearch;	/* textentry found for last search */
+	GHashTable *grams;		/* textentry -> byte pair filter, see xtext.c */
 } xtext_buffer;
 
 struct _GtkXText
@@ -264,7 +267,7 @@ void gtk_xtext_set_palette (GtkXText * xtext, GdkColor palette[]);
 void gtk_xtext_clear (xtext_buffer *buf, int lines);
 void gtk_xtext_save (GtkXText * xtext, int fh);
 void gtk_xtext_refresh (GtkXText * xtext);
-int gtk_xtext_lastlog (xtext_buffer *out, xtext_buffer *search_area);
+int gtk_xtext_lastlog (xtext_buffer *out, xtext_buffer *search_area, const char *title);
 textentry *gtk_xtext_search (GtkXText * xtext, const gchar *text, gtk_xtext_search_flags flags, GError **err);
 void gtk_xtext_reset_marker_pos (GtkXText *xtext);
 int gtk_xtext_moveto_marker_pos (GtkXText *xtext);
@@ -686,6 +686,10 @@ void
 fe_userlist_insert (struct session *sess, struct User *newuser, gboolean sel)
 {
 }
+void
+fe_userlist_insert_list (struct session *sess, GPtrArray *users)
+{
+}
 int
 fe_userlist_remove (struct session *sess, struct User *user)
 {